@@ -0,0 +1,191 @@
+#include "bench.h"
+#include "latency.h"
+#include "mem.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <ctime>
+
+bench_state::bench_state(int L, long long batch, double min_time, long long max_iters){
+	this->L = L;
+	this->batch = batch;
+	this->min_time = min_time;
+	this->max_iters = max_iters;
+	total = 0;
+	paused = 0;
+	running = false;
+}
+
+bool bench_state::keep_running(){
+	auto now = chrono::steady_clock::now();
+	if(running){
+		double ns = chrono::duration<double, nano>(now - start).count() - paused;
+		samples.push_back(ns);
+		total += ns;
+	}
+
+	running = samples.empty() || (total < min_time*1e9 && (long long)samples.size() < max_iters);
+	paused = 0;
+	start = chrono::steady_clock::now();
+	return running;
+}
+
+void bench_state::pause(){
+	paused_at = chrono::steady_clock::now();
+}
+
+void bench_state::resume(){
+	paused += chrono::duration<double, nano>(chrono::steady_clock::now() - paused_at).count();
+}
+
+
+void bench_state::counter(const string& name, double value){
+	counters.push_back(make_pair(name,value));
+}
+
+
+vector<bench_case>& bench_registry(){
+	static vector<bench_case> cases;
+	return cases;
+}
+
+int bench_register(const char* name, void (*fn)(bench_state&), bool batched){
+	bench_case c;
+	c.name = name;
+	c.fn = fn;
+	c.batched = batched;
+	bench_registry().push_back(c);
+	return 0;
+}
+
+static vector<pair<string,string> >& context(){
+	static vector<pair<string,string> > items;
+	return items;
+}
+
+void bench_context(const string& key, const string& value){
+	context().push_back(make_pair(key,value));
+}
+
+template< class T >
+static vector<T> parse_list(const string& s){
+	vector<T> out;
+	stringstream ss(s);
+	string item;
+	while(getline(ss,item,','))
+		out.push_back((T)atoll(item.c_str()));
+	return out;
+}
+
+bool bench_parse(int argc, char** argv, bench_options& options){
+	options.Ls = vector<int>(1,10);
+	options.batches = {1,16,256};
+	options.min_time = 0.5;
+	options.max_iters = 1000;
+
+	for(int i=1;i<argc;i++){
+		string arg = argv[i];
+		size_t eq = arg.find('=');
+		if(arg.compare(0,2,"--")!=0 || eq==string::npos){
+			cerr<<"unknown argument "<<arg<<endl;
+			return false;
+		}
+		string key = arg.substr(2,eq-2), value = arg.substr(eq+1);
+
+		if(key=="filter")
+			options.filter = value;
+		else if(key=="L")
+			options.Ls = parse_list<int>(value);
+		else if(key=="batch")
+			options.batches = parse_list<long long>(value);
+		else if(key=="min_time")
+			options.min_time = atof(value.c_str());
+		else if(key=="max_iters")
+			options.max_iters = atoll(value.c_str());
+		else if(key=="json")
+			options.json = value;
+		else{
+			cerr<<"unknown argument "<<arg<<endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+static string json_string(const string& s){
+	string out = "\"";
+	for(size_t i=0;i<s.size();i++){
+		if(s[i]=='"' || s[i]=='\\')
+			out += '\\';
+		out += s[i];
+	}
+	return out+"\"";
+}
+
+int bench_run(bench_options& options){
+	stringstream out;
+
+	time_t now = time(NULL);
+	char date[64];
+	strftime(date,sizeof(date),"%Y-%m-%dT%H:%M:%S",localtime(&now));
+
+	out<<"{\n  \"context\": {\n    \"date\": "<<json_string(date);
+	for(size_t i=0;i<context().size();i++)
+		out<<",\n    "<<json_string(context()[i].first)<<": "<<json_string(context()[i].second);
+	out<<"\n  },\n  \"benchmarks\": [";
+
+	bool first = true;
+	vector<bench_case>& cases = bench_registry();
+	for(size_t l=0;l<options.Ls.size();l++){
+		for(size_t c=0;c<cases.size();c++){
+			if(cases[c].name.find(options.filter)==string::npos)
+				continue;
+
+			vector<long long> batches = cases[c].batched ? options.batches : vector<long long>(1,1);
+			for(size_t b=0;b<batches.size();b++){
+				bench_state st(options.Ls[l],batches[b],options.min_time,options.max_iters);
+				rss_reset_peak();
+				cases[c].fn(st);
+				long long peak_rss = rss_peak_kb();
+				if(st.samples.empty())
+					continue;
+
+				latency_histogram h;
+				for(size_t i=0;i<st.samples.size();i++)
+					h.record((long long)st.samples[i]);
+				double mean = h.mean();
+
+				cerr<<cases[c].name<<" L="<<st.L<<" batch="<<st.batch<<" "<<mean/1e3<<" us x"<<st.samples.size()<<endl;
+
+				out<<(first ? "\n" : ",\n");
+				first = false;
+				out<<"    {\"name\": "<<json_string(cases[c].name)<<", \"L\": "<<st.L<<", \"batch\": "<<st.batch
+				   <<", \"iterations\": "<<st.samples.size()<<", \"mean_ns\": "<<(long long)mean
+				   <<", \"min_ns\": "<<h.min()<<", \"max_ns\": "<<h.max()
+				   <<", \"p50_ns\": "<<h.percentile(50)<<", \"p90_ns\": "<<h.percentile(90)
+				   <<", \"p99_ns\": "<<h.percentile(99)<<", \"p999_ns\": "<<h.percentile(99.9)
+				   <<", \"ns_per_item\": "<<(long long)(mean/st.batch)<<", \"peak_rss_kb\": "<<peak_rss;
+				for(size_t k=0;k<st.counters.size();k++)
+					out<<", "<<json_string(st.counters[k].first)<<": "<<st.counters[k].second;
+				out<<"}";
+			}
+		}
+	}
+	out<<"\n  ]\n}\n";
+
+	if(options.json.empty())
+		cout<<out.str();
+	else{
+		ofstream f(options.json);
+		f<<out.str();
+		if(!f){
+			cerr<<"cannot write "<<options.json<<endl;
+			return 1;
+		}
+	}
+	return 0;
+}
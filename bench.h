@@ -0,0 +1,69 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "benchmark.h"
+
+using namespace std;
+
+//small benchmark runner for vcs_bench (benchmark.h is only the header, it provides DoNotOptimize and
+//ClobberMemory). cases register with BENCH_CASE and run once per depth L and, if batched, once per batch size.
+//results are written as JSON so runs of two builds can be diffed.
+
+class bench_state{
+	public:
+	int L;
+	long long batch;
+	vector<double> samples; //ns of every timed iteration
+	vector<pair<string,double> > counters; //other per-iteration values of the case, e.g. bytes read
+
+	bench_state(int L, long long batch, double min_time, long long max_iters);
+
+	//while(st.keep_running()){ ... } times each pass of the loop body
+	bool keep_running();
+	//time between pause() and resume() is not counted, for per-iteration setup
+	void pause();
+	void resume();
+	void counter(const string& name, double value);
+
+	private:
+	double min_time, total;
+	long long max_iters;
+	bool running;
+	chrono::steady_clock::time_point start, paused_at;
+	double paused;
+};
+
+struct bench_case{
+	string name;
+	void (*fn)(bench_state&);
+	bool batched;
+};
+
+vector<bench_case>& bench_registry();
+int bench_register(const char* name, void (*fn)(bench_state&), bool batched);
+
+#define BENCH_CASE(fn) static int fn##_registered = bench_register(#fn, fn, false)
+#define BENCH_CASE_BATCHED(fn) static int fn##_registered = bench_register(#fn, fn, true)
+
+struct bench_options{
+	string filter; //run only cases whose name contains it
+	vector<int> Ls;
+	vector<long long> batches;
+	double min_time; //seconds of timed iterations per case, at least one iteration runs
+	long long max_iters;
+	string json; //output file, stdout if empty
+};
+
+//--filter=name --L=10,14 --batch=1,16,256 --min_time=0.5 --max_iters=1000 --json=out.json
+bool bench_parse(int argc, char** argv, bench_options& options);
+
+//key/value pairs written to the "context" object of the output
+void bench_context(const string& key, const string& value);
+
+int bench_run(bench_options& options);
+
+#endif
@@ -1,3 +1,5 @@
 #!/bin/bash
 
 ./test 10 > bench.csv
+./vcs_bench --L=10,14,18 --batch=1,16,256 --json=bench.json
+./bench_throughput 16 2 > throughput.csv
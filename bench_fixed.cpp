@@ -0,0 +1,102 @@
+#include "vcs.h"
+#include "vcs_fixed.h"
+
+#include "benchmark.h"
+
+#include <iostream>
+#include <random>
+#include <chrono>
+
+#include "test_point.hpp"
+#include "bn.h"
+
+using namespace std;
+using namespace bn;
+
+//compares the runtime vcs with vcs_fixed<L> on verify, update_digest and update_proof.
+//proofs, update keys and vrk are random group elements: the cost does not depend on them being valid.
+//prints one row per operation and depth: op,L,runtime_us,fixed_us (averages over iters)
+
+template< int L >
+void bench_depth(mpz_class p, Ec1 g1, Ec2 g2, mt19937_64& gen, int iters){
+	vcs a(L,p,g1,g2);
+	vcs_fixed<L> b(p,g1,g2);
+	
+	vector<Ec1> proof(L), upk(L);
+	vector<Ec2> vrk(L);
+	for(int i=0;i<L;i++){
+		proof[i] = g1*(unsigned int)gen();
+		upk[i] = g1*(unsigned int)gen();
+		vrk[i] = g2*(unsigned int)gen();
+	}
+	typename vcs_fixed<L>::proof_t proof_f = vcs_fixed<L>::to_array(proof), upk_f = vcs_fixed<L>::to_array(upk);
+	typename vcs_fixed<L>::vrk_t vrk_f = vcs_fixed<L>::to_array(vrk);
+	
+	Ec1 digest = g1*(unsigned int)gen();
+	mpz_class value = (unsigned int)gen(), delta = (unsigned int)gen();
+	
+	vector<long long> index(iters), updateindex(iters);
+	for(int j=0;j<iters;j++){
+		index[j] = gen() % a.N;
+		updateindex[j] = gen() % a.N;
+	}
+	
+	double t_runtime, t_fixed;
+	chrono::steady_clock::time_point t1;
+	
+	t1 = chrono::steady_clock::now();
+	for(int j=0;j<iters;j++)
+		benchmark::DoNotOptimize(a.verify(digest, index[j], value, proof, vrk));
+	t_runtime = chrono::duration<double, micro>(chrono::steady_clock::now()-t1).count()/iters;
+	t1 = chrono::steady_clock::now();
+	for(int j=0;j<iters;j++)
+		benchmark::DoNotOptimize(b.verify(digest, index[j], value, proof_f, vrk_f));
+	t_fixed = chrono::duration<double, micro>(chrono::steady_clock::now()-t1).count()/iters;
+	cout << "verify," << L << "," << t_runtime << "," << t_fixed << endl;
+	
+	t1 = chrono::steady_clock::now();
+	for(int j=0;j<iters;j++)
+		benchmark::DoNotOptimize(digest = a.update_digest(digest, updateindex[j], delta, upk));
+	t_runtime = chrono::duration<double, micro>(chrono::steady_clock::now()-t1).count()/iters;
+	t1 = chrono::steady_clock::now();
+	for(int j=0;j<iters;j++)
+		benchmark::DoNotOptimize(digest = b.update_digest(digest, updateindex[j], delta, upk_f));
+	t_fixed = chrono::duration<double, micro>(chrono::steady_clock::now()-t1).count()/iters;
+	cout << "update_digest," << L << "," << t_runtime << "," << t_fixed << endl;
+	
+	t1 = chrono::steady_clock::now();
+	for(int j=0;j<iters;j++)
+		benchmark::DoNotOptimize(proof = a.update_proof(proof, updateindex[j], index[j], delta, upk));
+	t_runtime = chrono::duration<double, micro>(chrono::steady_clock::now()-t1).count()/iters;
+	t1 = chrono::steady_clock::now();
+	for(int j=0;j<iters;j++)
+		benchmark::DoNotOptimize(proof_f = b.update_proof(proof_f, updateindex[j], index[j], delta, upk_f));
+	t_fixed = chrono::duration<double, micro>(chrono::steady_clock::now()-t1).count()/iters;
+	cout << "update_proof," << L << "," << t_runtime << "," << t_fixed << endl;
+}
+
+int main(int argc, char** argv){
+	int iters = argc>1 ? atoi(argv[1]) : 100;
+	
+	bn::CurveParam cp = bn::CurveFp254BNb;
+	Param::init(cp);
+	const Point& pt = selectPoint(cp);
+	const Ec2 g2(
+		Fp2(Fp(pt.g2.aa), Fp(pt.g2.ab)),
+		Fp2(Fp(pt.g2.ba), Fp(pt.g2.bb))
+	);
+	const Ec1 g1(pt.g1.a, pt.g1.b);
+	
+	mpz_class p;
+	p.set_str("16798108731015832284940804142231733909759579603404752749028378864165570215949",10);
+	
+	mt19937_64 gen(1);
+	
+	cout << "op,L,runtime_us,fixed_us" << endl;
+	bench_depth<16>(p,g1,g2,gen,iters);
+	bench_depth<20>(p,g1,g2,gen,iters);
+	bench_depth<24>(p,g1,g2,gen,iters);
+	bench_depth<28>(p,g1,g2,gen,iters);
+	
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include "vcs.h"
+#include "commitment_state.h"
+
+#include "benchmark.h"
+
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#include "test_point.hpp"
+#include "bn.h"
+
+using namespace std;
+using namespace bn;
+
+//./bench_throughput [number] [seconds] [max_threads]
+//K threads run one operation against one loaded key set for the given seconds (default 2), for K = 1, 2, 4, ...
+//up to max_threads (default: all cores). prints op,threads,ops_per_sec,speedup,efficiency where efficiency is
+//ops_per_sec/(K*ops_per_sec at K=1); it drops when threads contend on the key files, the allocator or locks.
+//"mixed" cycles through the first four operations in every thread. "ingest" appends updates of the pool indices to
+//a commitment_state, whose writer coalesces and applies them meanwhile. its rate counts the appends only;
+//"ingest_applied" divides the same updates by the time until the writer has applied all of them.
+
+#define POOL 64 //indices with a proof and an update key, shared read-only by all threads
+
+enum throughput_op{ T_VERIFY, T_UPDATE_DIGEST, T_UPDATE_PROOF, T_CALC_UPDATE_KEY, T_MIXED, T_INGEST, T_COUNT };
+static const char* op_names[T_COUNT] = {"verify", "update_digest", "update_proof", "calc_update_key", "mixed", "ingest"};
+
+struct shared_keys{
+	vcs* a;
+	vector<vector<Ec1> >* prk;
+	vector<Ec2>* vrk;
+	commitment_state* state;
+	Ec1 digest;
+	vector<long long> index;
+	vector<mpz_class> value, delta;
+	vector<vector<Ec1> > proofs, upks;
+	atomic<bool> stop;
+};
+
+static void worker(int op, int t, shared_keys* s, long long* count){
+	mt19937_64 gen(t);
+	Ec1 digest = s->digest;
+	vector<Ec1> proof = s->proofs[0];
+	long long n = 0;
+
+	while(!s->stop.load(memory_order_relaxed)){
+		int j = gen()%POOL, k = gen()%POOL;
+		int o = op==T_MIXED ? n%T_MIXED : op;
+		switch(o){
+			case T_VERIFY:
+				benchmark::DoNotOptimize(s->a->verify(s->digest, s->index[j], s->value[j], s->proofs[j], *s->vrk));
+				break;
+			case T_UPDATE_DIGEST:
+				benchmark::DoNotOptimize(digest = s->a->update_digest(digest, s->index[k], s->delta[k], s->upks[k]));
+				break;
+			case T_UPDATE_PROOF:
+				benchmark::DoNotOptimize(proof = s->a->update_proof(proof, s->index[k], s->index[0], s->delta[k], s->upks[k]));
+				break;
+			case T_CALC_UPDATE_KEY:
+				benchmark::DoNotOptimize(s->a->calc_update_key(gen()%s->a->N, *s->prk));
+				break;
+			case T_INGEST:
+				s->state->update(s->index[k], s->delta[k]);
+				break;
+		}
+		n++;
+	}
+	*count = n;
+}
+
+//total operations per second of K threads. for ingest, applied is the rate up to the end of the flush
+static double run(int op, int K, double seconds, shared_keys& s, double& applied){
+	vector<thread> th(K);
+	vector<long long> count(K);
+	s.stop.store(false);
+
+	auto t1 = chrono::steady_clock::now();
+	for(int t=0;t<K;t++)
+		th[t] = thread(worker, op, t, &s, &count[t]);
+	this_thread::sleep_for(chrono::duration<double>(seconds));
+	s.stop.store(true);
+	for(int t=0;t<K;t++)
+		th[t].join();
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now()-t1).count();
+
+	long long total = 0;
+	for(int t=0;t<K;t++)
+		total += count[t];
+	if(op==T_INGEST){
+		s.state->flush();
+		applied = total/chrono::duration<double>(chrono::steady_clock::now()-t1).count();
+	}
+	return total/elapsed;
+}
+
+int main(int argc, char** argv){
+	int L = argc>1 ? atoi(argv[1]) : 10;
+	double seconds = argc>2 ? atof(argv[2]) : 2;
+	int max_threads = argc>3 ? atoi(argv[3]) : thread::hardware_concurrency();
+	if(max_threads<1)
+		max_threads = 1;
+
+	bn::CurveParam cp = bn::CurveFp254BNb;
+	Param::init(cp);
+	const Point& pt = selectPoint(cp);
+	const Ec2 g2(
+		Fp2(Fp(pt.g2.aa), Fp(pt.g2.ab)),
+		Fp2(Fp(pt.g2.ba), Fp(pt.g2.bb))
+	);
+	const Ec1 g1(pt.g1.a, pt.g1.b);
+
+	mpz_class p;
+	p.set_str("16798108731015832284940804142231733909759579603404752749028378864165570215949",10);
+
+	mt19937_64 gen(1);
+
+	vcs a(L,p,g1,g2);
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	if(!a.keygen(prk,vrk) || !a.load_key(prk,vrk)){
+		cerr<<"keygen or load_key failed"<<endl;
+		return 1;
+	}
+
+	vector<mpz_class> vals(a.N);
+	for(long long i=0;i<a.N;i++)
+		vals[i] = (unsigned int)gen();
+
+	shared_keys s;
+	s.a = &a;
+	s.prk = &prk;
+	s.vrk = &vrk;
+	s.digest = a.setup(vals,prk);
+	for(int j=0;j<POOL;j++){
+		s.index.push_back(gen()%a.N);
+		s.value.push_back(vals[s.index[j]]);
+		s.delta.push_back((unsigned int)gen());
+	}
+	s.upks = a.calc_update_key_batch(s.index,prk);
+	for(int j=0;j<POOL;j++)
+		s.proofs.push_back(a.prove(s.index[j],vals,prk));
+
+	//calc_update_key runs in the workers too, so the engine starts after those measurements
+	sparse_vector sv;
+	for(long long i=0;i<a.N;i++)
+		sv.set(i,vals[i]);
+	s.state = NULL;
+
+	vector<int> Ks;
+	for(int K=1;K<max_threads;K*=2)
+		Ks.push_back(K);
+	Ks.push_back(max_threads);
+
+	cout << "op,threads,ops_per_sec,speedup,efficiency" << endl;
+	for(int op=0;op<T_COUNT;op++){
+		if(op==T_INGEST){
+			s.state = new commitment_state(a,prk,vrk,sv);
+			for(int j=0;j<4;j++)
+				s.state->track(s.index[j]);
+			s.state->flush();
+		}
+		double base = 0, applied_base = 0;
+		for(int K : Ks){
+			double applied = 0;
+			double rate = run(op,K,seconds,s,applied);
+			if(K==1){
+				base = rate;
+				applied_base = applied;
+			}
+			cout << op_names[op] << "," << K << "," << rate << "," << rate/base << "," << rate/base/K << endl;
+			if(op==T_INGEST)
+				cout << "ingest_applied," << K << "," << applied << "," << applied/applied_base << "," << applied/applied_base/K << endl;
+		}
+	}
+
+	return 0;
+}
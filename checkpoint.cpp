@@ -0,0 +1,434 @@
+#include "checkpoint.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+static inline size_t align_up(size_t x, size_t a){
+	return (x+a-1)/a*a;
+}
+
+size_t checkpoint_proof_bytes(int L){
+	return align_up(16+L*sizeof(Ec1),8);
+}
+
+//FNV-1a over 64-bit words with a fold of the high half after every step, so a change in any bit reaches all of
+//the following state
+uint64_t checkpoint_checksum(const void* data, size_t n, uint64_t h){
+	const unsigned char* b = (const unsigned char*)data;
+	size_t i = 0;
+	for(;i+8<=n;i+=8){
+		uint64_t w;
+		memcpy(&w,b+i,8);
+		h = (h^w)*1099511628211ULL;
+		h ^= h>>32;
+	}
+	for(;i<n;i++)
+		h = (h^b[i])*1099511628211ULL;
+	return h;
+}
+
+void checkpoint_encode_value(checkpoint_value& e, long long index, const mpz_class& v, const mpz_class& p){
+	mpz_class m = abs(v);
+	e.index = index;
+	e.sign = sgn(v)<0 ? 1 : 0;
+	if(mpz_sizeinbase(m.get_mpz_t(),2)>256){
+		m = v % p;
+		if(m<0)
+			m += p;
+		e.sign = 0;
+	}
+	memset(e.limb,0,sizeof(e.limb));
+	mpz_export(e.limb,NULL,-1,sizeof(uint64_t),0,0,m.get_mpz_t());
+}
+
+mpz_class checkpoint_decode_value(const checkpoint_value& e){
+	mpz_class v;
+	mpz_import(v.get_mpz_t(),4,-1,sizeof(uint64_t),0,0,e.limb);
+	if(e.sign)
+		v = -v;
+	return v;
+}
+
+static bool write_all(int fd, const void* data, size_t n){
+	const char* b = (const char*)data;
+	while(n>0){
+		ssize_t w = write(fd,b,n);
+		if(w<=0)
+			return false;
+		b += w;
+		n -= w;
+	}
+	return true;
+}
+
+//a rename, create or unlink is only durable once the directory holding the file is synced
+static bool sync_dir(const string& filename){
+	size_t slash = filename.rfind('/');
+	string dir = slash==string::npos ? "." : filename.substr(0,slash+1);
+	int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+	if(fd<0)
+		return false;
+	bool ok = fsync(fd)==0;
+	close(fd);
+	return ok;
+}
+
+static bool write_zeros(int fd, size_t n){
+	static const char zeros[CHECKPOINT_ALIGN] = {0};
+	return write_all(fd,zeros,n);
+}
+
+bool checkpoint_save(const string& filename, int L, long long seq, const Ec1& digest, const vector<checkpoint_value>& values, const map<long long, vector<Ec1> >& proofs){
+	size_t proof_bytes = checkpoint_proof_bytes(L);
+	vector<unsigned char> proof_buf(proofs.size()*proof_bytes,0);
+	size_t k = 0;
+	for(auto& e : proofs){
+		unsigned char* entry = &proof_buf[k*proof_bytes];
+		int64_t index = e.first;
+		memcpy(entry,&index,8);
+		memcpy(entry+16,&e.second[0],L*sizeof(Ec1));
+		k++;
+	}
+
+	checkpoint_header h;
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,CHECKPOINT_MAGIC,8);
+	h.L = L;
+	h.ec1_bytes = sizeof(Ec1);
+	h.seq = seq;
+	h.nvalues = values.size();
+	h.nproofs = proofs.size();
+	h.values_offset = align_up(sizeof(h)+sizeof(Ec1),CHECKPOINT_ALIGN);
+	h.proofs_offset = align_up(h.values_offset+values.size()*sizeof(checkpoint_value),CHECKPOINT_ALIGN);
+	h.bytes = h.proofs_offset+proof_buf.size();
+	h.values_checksum = checkpoint_checksum(values.data(),values.size()*sizeof(checkpoint_value));
+	h.proofs_checksum = checkpoint_checksum(proof_buf.data(),proof_buf.size());
+	h.header_checksum = checkpoint_checksum(&digest,sizeof(Ec1),checkpoint_checksum(&h,offsetof(checkpoint_header,header_checksum)));
+
+	string tmp = filename+".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd<0){
+		cerr<<"checkpoint_save: cannot create "<<tmp<<endl;
+		return false;
+	}
+	bool ok = write_all(fd,&h,sizeof(h))
+		&& write_all(fd,&digest,sizeof(Ec1))
+		&& write_zeros(fd,h.values_offset-sizeof(h)-sizeof(Ec1))
+		&& write_all(fd,values.data(),values.size()*sizeof(checkpoint_value))
+		&& write_zeros(fd,h.proofs_offset-h.values_offset-values.size()*sizeof(checkpoint_value))
+		&& write_all(fd,proof_buf.data(),proof_buf.size())
+		&& fsync(fd)==0;
+	close(fd);
+	if(!ok || rename(tmp.c_str(),filename.c_str())!=0){
+		cerr<<"checkpoint_save: writing "<<filename<<" failed"<<endl;
+		unlink(tmp.c_str());
+		return false;
+	}
+	//the caller deletes the log this checkpoint covers next, which must not survive a crash that loses the rename
+	if(!sync_dir(filename)){
+		cerr<<"checkpoint_save: syncing the directory of "<<filename<<" failed"<<endl;
+		return false;
+	}
+	return true;
+}
+
+checkpoint_file::checkpoint_file(){
+	base = NULL;
+	bytes = 0;
+	h = NULL;
+}
+
+checkpoint_file::~checkpoint_file(){
+	close();
+}
+
+void checkpoint_file::close(){
+	if(base!=NULL)
+		munmap((void*)base,bytes);
+	base = NULL;
+	h = NULL;
+}
+
+bool checkpoint_file::open(const string& filename, int L, bool verify){
+	close();
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd<0)
+		return false;
+	struct stat st;
+	if(fstat(fd,&st)!=0 || (size_t)st.st_size<sizeof(checkpoint_header)+sizeof(Ec1)){
+		::close(fd);
+		return false;
+	}
+	bytes = st.st_size;
+	void* p = mmap(NULL,bytes,PROT_READ,MAP_PRIVATE,fd,0);
+	::close(fd);
+	if(p==MAP_FAILED)
+		return false;
+	base = (const unsigned char*)p;
+	h = (const checkpoint_header*)base;
+
+	const char* error = NULL;
+	if(memcmp(h->magic,CHECKPOINT_MAGIC,8)!=0)
+		error = "not a checkpoint";
+	else if(h->header_checksum!=checkpoint_checksum(base+sizeof(checkpoint_header),sizeof(Ec1),checkpoint_checksum(h,offsetof(checkpoint_header,header_checksum))))
+		error = "bad header checksum";
+	else if(h->L!=L || h->ec1_bytes!=(int32_t)sizeof(Ec1))
+		error = "written for another L or point format";
+	else if((size_t)h->bytes!=bytes || h->values_offset+h->nvalues*(int64_t)sizeof(checkpoint_value)>h->proofs_offset
+		|| h->proofs_offset+h->nproofs*(int64_t)checkpoint_proof_bytes(L)!=h->bytes)
+		error = "truncated";
+	else if(verify && h->values_checksum!=checkpoint_checksum(base+h->values_offset,h->nvalues*sizeof(checkpoint_value)))
+		error = "bad values checksum";
+	else if(verify && h->proofs_checksum!=checkpoint_checksum(base+h->proofs_offset,h->nproofs*checkpoint_proof_bytes(L)))
+		error = "bad proofs checksum";
+	if(error!=NULL){
+		cerr<<"checkpoint_file: "<<filename<<": "<<error<<endl;
+		close();
+		return false;
+	}
+
+	madvise(p,bytes,MADV_SEQUENTIAL);
+	return true;
+}
+
+long long checkpoint_file::seq() const{
+	return h->seq;
+}
+
+Ec1 checkpoint_file::digest() const{
+	Ec1 d;
+	memcpy(&d,base+sizeof(checkpoint_header),sizeof(Ec1));
+	return d;
+}
+
+size_t checkpoint_file::nvalues() const{
+	return h->nvalues;
+}
+
+const checkpoint_value* checkpoint_file::values() const{
+	return (const checkpoint_value*)(base+h->values_offset);
+}
+
+mpz_class checkpoint_file::value(long long index) const{
+	const checkpoint_value* v = values();
+	const checkpoint_value* it = lower_bound(v,v+h->nvalues,index,[](const checkpoint_value& e, long long i){ return e.index<i; });
+	if(it==v+h->nvalues || it->index!=index)
+		return 0;
+	return checkpoint_decode_value(*it);
+}
+
+size_t checkpoint_file::nproofs() const{
+	return h->nproofs;
+}
+
+long long checkpoint_file::proof_index(size_t k) const{
+	int64_t index;
+	memcpy(&index,base+h->proofs_offset+k*checkpoint_proof_bytes(h->L),8);
+	return index;
+}
+
+void checkpoint_file::proof(size_t k, vector<Ec1>& out) const{
+	out.resize(h->L);
+	memcpy(&out[0],base+h->proofs_offset+k*checkpoint_proof_bytes(h->L)+16,h->L*sizeof(Ec1));
+}
+
+update_wal::update_wal(const string& prefix, bool sync){
+	this->prefix = prefix;
+	this->sync = sync;
+	fd = -1;
+	covered = 0;
+	rotate = false;
+}
+
+update_wal::~update_wal(){
+	if(fd>=0)
+		close(fd);
+}
+
+string update_wal::segment_file(const string& prefix, long long first){
+	return prefix+"."+to_string(first);
+}
+
+//prefix.<digits> in the directory of prefix, by first seq
+vector<long long> update_wal::list_segments(const string& prefix){
+	size_t slash = prefix.rfind('/');
+	string dir = slash==string::npos ? "." : prefix.substr(0,slash+1);
+	string name = (slash==string::npos ? prefix : prefix.substr(slash+1))+".";
+
+	vector<long long> firsts;
+	DIR* d = opendir(dir.c_str());
+	if(d==NULL)
+		return firsts;
+	struct dirent* e;
+	while((e = readdir(d))!=NULL){
+		string f = e->d_name;
+		if(f.compare(0,name.size(),name)!=0 || f.size()==name.size())
+			continue;
+		string digits = f.substr(name.size());
+		if(digits.find_first_not_of("0123456789")==string::npos)
+			firsts.push_back(atoll(digits.c_str()));
+	}
+	closedir(d);
+	sort(firsts.begin(),firsts.end());
+	return firsts;
+}
+
+bool update_wal::start_segment(long long first){
+	if(fd>=0)
+		close(fd);
+	fd = -1;
+	//a segment starting at first cannot hold a valid record yet, anything in it is a torn leftover
+	fd = ::open(segment_file(prefix,first).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR);
+	if(fd<0 || !sync_dir(prefix)){
+		cerr<<"update_wal: cannot create "<<segment_file(prefix,first)<<endl;
+		if(fd>=0)
+			close(fd);
+		fd = -1;
+		return false;
+	}
+	if(segments.empty() || segments.back()!=first)
+		segments.push_back(first);
+	return true;
+}
+
+bool update_wal::open(long long next_seq, bool fresh){
+	lock_guard<mutex> l(m);
+	segments = list_segments(prefix);
+	if(fresh){
+		for(long long first : segments)
+			unlink(segment_file(prefix,first).c_str());
+		segments.clear();
+	}
+	//segments from next_seq on hold nothing that replay accepted
+	while(!segments.empty() && segments.back()>=next_seq){
+		unlink(segment_file(prefix,segments.back()).c_str());
+		segments.pop_back();
+	}
+	return start_segment(next_seq);
+}
+
+bool update_wal::append(long long first_seq, vector<update_record*>& records){
+	lock_guard<mutex> l(m);
+	if(rotate){
+		rotate = false;
+		//old segments only go once the new one exists
+		if(start_segment(first_seq)){
+			while(segments.size()>1 && segments[1]-1<=covered){
+				unlink(segment_file(prefix,segments[0]).c_str());
+				segments.erase(segments.begin());
+			}
+		}
+	}
+	if(fd<0){
+		cerr<<"update_wal: no open segment for records "<<first_seq<<".."<<endl;
+		return false;
+	}
+
+	buf.clear();
+	for(size_t k=0;k<records.size();k++){
+		size_t start = buf.size();
+		int64_t head[2] = {first_seq+(long long)k, records[k]->index};
+		size_t len = (mpz_sizeinbase(records[k]->delta.get_mpz_t(),2)+7)/8;
+		int32_t slen = sgn(records[k]->delta)<0 ? -(int32_t)len : (int32_t)len;
+		buf.resize(start+sizeof(head)+sizeof(slen)+len+sizeof(uint32_t));
+		unsigned char* r = &buf[start];
+		memcpy(r,head,sizeof(head));
+		memcpy(r+sizeof(head),&slen,sizeof(slen));
+		if(records[k]->delta!=0)
+			mpz_export(r+sizeof(head)+sizeof(slen),NULL,1,1,1,0,records[k]->delta.get_mpz_t());
+		uint32_t check = checkpoint_checksum(r,sizeof(head)+sizeof(slen)+len);
+		memcpy(r+sizeof(head)+sizeof(slen)+len,&check,sizeof(check));
+	}
+	if(!write_all(fd,buf.data(),buf.size()) || (sync && fdatasync(fd)!=0)){
+		cerr<<"update_wal: writing records "<<first_seq<<".. failed"<<endl;
+		return false;
+	}
+	return true;
+}
+
+void update_wal::checkpointed(long long seq){
+	lock_guard<mutex> l(m);
+	covered = max(covered,seq);
+	rotate = true;
+}
+
+bool update_wal::replay(const string& prefix, long long after_seq, vector<pair<long long, mpz_class> >& out, long long& last_seq){
+	vector<long long> segments = list_segments(prefix);
+	last_seq = after_seq;
+	long long expected = -1; //seq of the next record, -1 until the first record is read
+	for(size_t s=0;s<segments.size();s++){
+		bool last = s+1==segments.size();
+		if(!last && segments[s+1]-1<=after_seq)
+			continue;
+		string filename = segment_file(prefix,segments[s]);
+		int fd = ::open(filename.c_str(), last ? O_RDWR : O_RDONLY);
+		if(fd<0)
+			return false;
+		struct stat st;
+		fstat(fd,&st);
+		vector<unsigned char> data(st.st_size);
+		bool ok = st.st_size==0 || pread(fd,&data[0],st.st_size,0)==st.st_size;
+
+		size_t pos = 0;
+		while(ok && pos<data.size()){
+			int64_t head[2];
+			int32_t slen;
+			uint32_t check;
+			if(data.size()-pos<sizeof(head)+sizeof(slen))
+				break;
+			memcpy(head,&data[pos],sizeof(head));
+			memcpy(&slen,&data[pos+sizeof(head)],sizeof(slen));
+			size_t len = abs(slen);
+			size_t rec = sizeof(head)+sizeof(slen)+len;
+			if(len>data.size() || data.size()-pos<rec+sizeof(check))
+				break;
+			memcpy(&check,&data[pos+rec],sizeof(check));
+			if(check!=(uint32_t)checkpoint_checksum(&data[pos],rec))
+				break;
+
+			if(expected>=0 && head[0]!=expected){
+				cerr<<"update_wal: "<<filename<<": record "<<head[0]<<" where "<<expected<<" was expected"<<endl;
+				close(fd);
+				return false;
+			}
+			if(expected<0 && head[0]>after_seq+1){
+				cerr<<"update_wal: records "<<after_seq+1<<".."<<head[0]-1<<" are missing"<<endl;
+				close(fd);
+				return false;
+			}
+			expected = head[0]+1;
+			if(head[0]>after_seq){
+				mpz_class delta;
+				if(len>0)
+					mpz_import(delta.get_mpz_t(),len,1,1,1,0,&data[pos+sizeof(head)+sizeof(slen)]);
+				if(slen<0)
+					delta = -delta;
+				out.push_back(make_pair((long long)head[1],delta));
+				last_seq = head[0];
+			}
+			pos += rec+sizeof(check);
+		}
+
+		if(ok && pos<data.size()){
+			if(!last){
+				cerr<<"update_wal: "<<filename<<": bad record at byte "<<pos<<endl;
+				close(fd);
+				return false;
+			}
+			ok = ftruncate(fd,pos)==0;
+		}
+		close(fd);
+		if(!ok)
+			return false;
+	}
+	return true;
+}
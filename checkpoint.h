@@ -0,0 +1,108 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <gmp.h>
+#include <gmpxx.h>
+#include "bn.h"
+#include "update_log.h"
+
+using namespace std;
+using namespace bn;
+
+#define CHECKPOINT_MAGIC "VCSCKPT1"
+#define CHECKPOINT_ALIGN 64
+
+//a checkpoint file is in host byte order and laid out to be mmapped and read in place: the header, the digest as a
+//raw Ec1 (like the key files), the values at values_offset and the proofs at proofs_offset
+struct checkpoint_header{
+	char magic[8];
+	int32_t L;
+	int32_t ec1_bytes; //sizeof(Ec1) of the writer, the points are only readable with the same
+	int64_t seq; //log records applied
+	int64_t nvalues, nproofs;
+	int64_t values_offset, proofs_offset, bytes;
+	uint64_t values_checksum, proofs_checksum;
+	uint64_t header_checksum; //of the fields above and the digest
+};
+
+//a non-zero entry of the vector, sorted by index. magnitudes of 2^256 and more are stored reduced mod p
+struct checkpoint_value{
+	int64_t index;
+	int64_t sign;
+	uint64_t limb[4]; //magnitude, least significant first
+};
+
+//a proof is stored as its index, 8 bytes of padding and L raw points
+size_t checkpoint_proof_bytes(int L);
+
+uint64_t checkpoint_checksum(const void* data, size_t n, uint64_t h = 14695981039346656037ULL);
+void checkpoint_encode_value(checkpoint_value& e, long long index, const mpz_class& v, const mpz_class& p);
+mpz_class checkpoint_decode_value(const checkpoint_value& e);
+
+//writes filename.tmp, syncs it and renames it over filename, so a crash leaves the old or the new checkpoint
+bool checkpoint_save(const string& filename, int L, long long seq, const Ec1& digest, const vector<checkpoint_value>& values, const map<long long, vector<Ec1> >& proofs);
+
+//read-only mapping of a checkpoint file
+class checkpoint_file{
+	public:
+	checkpoint_file();
+	~checkpoint_file();
+	//checks the header, and with verify the checksums of the values and proofs
+	bool open(const string& filename, int L, bool verify = true);
+	void close();
+
+	long long seq() const;
+	Ec1 digest() const;
+	size_t nvalues() const;
+	const checkpoint_value* values() const;
+	mpz_class value(long long index) const; //binary search, 0 if absent
+	size_t nproofs() const;
+	long long proof_index(size_t k) const;
+	void proof(size_t k, vector<Ec1>& out) const;
+
+	private:
+	const unsigned char* base;
+	size_t bytes;
+	const checkpoint_header* h;
+};
+
+//write-ahead log of the records applied by commitment_state, in segment files prefix.<seq of their first record>.
+//a record is seq, index, the byte length of delta (negative for a negative delta), its magnitude and a checksum of
+//the record, so a torn write at the end is detected
+class update_wal{
+	public:
+	update_wal(const string& prefix, bool sync);
+	~update_wal();
+	//starts a segment at next_seq; fresh deletes the segments of an earlier run first
+	bool open(long long next_seq, bool fresh);
+	//the records get first_seq, first_seq+1, ... and go out in one write, followed by fdatasync if sync
+	bool append(long long first_seq, vector<update_record*>& records);
+	//a checkpoint holds every record up to seq: the next append starts a new segment, and the segments whose
+	//records are all covered are deleted
+	void checkpointed(long long seq);
+
+	//the deltas of the records after after_seq, in order; last_seq is the seq of the last one. a torn record at the
+	//end of the last segment is cut off the file, a gap or a bad record anywhere else fails
+	static bool replay(const string& prefix, long long after_seq, vector<pair<long long, mpz_class> >& out, long long& last_seq);
+
+	private:
+	string prefix;
+	bool sync;
+	int fd;
+	mutex m; //append runs on the writer, checkpointed on the thread that saved the checkpoint
+	vector<long long> segments; //first seq of every segment on disk, ascending
+	long long covered;
+	bool rotate;
+	vector<unsigned char> buf;
+
+	bool start_segment(long long first);
+	static vector<long long> list_segments(const string& prefix);
+	static string segment_file(const string& prefix, long long first);
+};
+
+#endif
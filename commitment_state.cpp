@@ -0,0 +1,431 @@
+#include "commitment_state.h"
+#include "mem.h"
+#include "trace.h"
+
+#include <set>
+#include <iostream>
+
+struct value_node{
+	long long born;
+};
+
+struct value_inner : value_node{
+	void* child[STATE_FANOUT];
+};
+
+struct value_leaf : value_node{
+	mpz_class v[STATE_FANOUT];
+};
+
+static void delete_inner(void* p){
+	mem_add(MEM_STATE, -(long long)sizeof(value_inner));
+	delete (value_inner*)p;
+}
+
+static void delete_leaf(void* p){
+	mem_add(MEM_STATE, -(long long)sizeof(value_leaf));
+	delete (value_leaf*)p;
+}
+
+static void delete_version(void* p){
+	delete (state_version*)p;
+}
+
+static void delete_proofs(void* p){
+	delete (map<long long, vector<Ec1> >*)p;
+}
+
+static inline int digit(long long index, int depth, int levels){
+	return (index >> (STATE_FANOUT_BITS*(levels-1-depth))) & (STATE_FANOUT-1);
+}
+
+commitment_state::commitment_state(vcs& a, vector<vector<Ec1> >& prk, vector<Ec2>& vrk, sparse_vector& vals, const string& wal, bool sync) : a(a), prk(prk), vrk(vrk){
+	state_version* v = new state_version;
+	v->seq = 0;
+	bool read;
+	v->digest = a.setup(vals,prk,&read);
+	v->root = NULL;
+	v->proofs = new map<long long, vector<Ec1> >;
+	init(v);
+	for(auto& e : vals.entries)
+		add_value(v,e.first,e.second);
+	good = read;
+
+	if(good && !wal.empty()){
+		this->wal = new update_wal(wal,sync);
+		good = this->wal->open(1,true);
+	}
+	th = thread([](commitment_state* s){ s->writer(); }, this);
+}
+
+//values and proofs are copied out of the mapped checkpoint, the log after it goes through apply in drains of
+//STATE_DRAIN_MAX like live updates
+commitment_state::commitment_state(vcs& a, vector<vector<Ec1> >& prk, vector<Ec2>& vrk, const string& checkpoint, const string& wal, bool sync) : a(a), prk(prk), vrk(vrk){
+	TRACE_SPAN("state_recover");
+	state_version* v = new state_version;
+	v->seq = 0;
+	v->digest = a.g1*0;
+	v->root = NULL;
+	v->proofs = new map<long long, vector<Ec1> >;
+	init(v);
+
+	checkpoint_file f;
+	good = f.open(checkpoint,a.L);
+	if(good){
+		v->seq = f.seq();
+		v->digest = f.digest();
+		const checkpoint_value* values = f.values();
+		for(size_t k=0;k<f.nvalues();k++)
+			add_value(v,values[k].index,checkpoint_decode_value(values[k]));
+		for(size_t k=0;k<f.nproofs();k++)
+			f.proof(k,(*v->proofs)[f.proof_index(k)]);
+		f.close();
+
+		vector<pair<long long, mpz_class> > log;
+		long long last;
+		good = update_wal::replay(wal,v->seq,log,last);
+		vector<update_record*> records;
+		vector<long long> tracks;
+		for(size_t k=0;good && k<log.size();k+=STATE_DRAIN_MAX){
+			for(size_t j=k;j<min(log.size(),k+STATE_DRAIN_MAX);j++){
+				update_record* r = new update_record;
+				r->index = log[j].first;
+				r->delta = log[j].second;
+				records.push_back(r);
+			}
+			good = apply(records,tracks);
+			for(update_record* r : records)
+				delete r;
+			records.clear();
+		}
+	}
+	if(good){
+		this->wal = new update_wal(wal,sync);
+		good = this->wal->open(current.load()->seq+1,false);
+	}
+	th = thread([](commitment_state* s){ s->writer(); }, this);
+}
+
+void commitment_state::init(state_version* v){
+	levels = max(1, (a.L+STATE_FANOUT_BITS-1)/STATE_FANOUT_BITS);
+	build = 0;
+	applied_ticket = 0;
+	stop = busy = false;
+	sleeping.store(false);
+	wal = NULL;
+	good.store(true);
+	current.store(v);
+}
+
+commitment_state::~commitment_state(){
+	{
+		lock_guard<mutex> l(m);
+		stop = true;
+	}
+	queued.notify_one();
+	th.join();
+	delete wal;
+
+	state_version* v = current.load();
+	free_tree(v->root,0);
+	delete v->proofs;
+	delete v;
+}
+
+bool commitment_state::ok() const{
+	return good.load();
+}
+
+//the writer sets sleeping before it checks the log under m, producers append before they read sleeping, so
+//one of them sees the other. taking m orders the notify after the writer started waiting
+void commitment_state::wake(){
+	if(sleeping.load()){
+		{
+			lock_guard<mutex> l(m);
+		}
+		queued.notify_one();
+	}
+}
+
+long long commitment_state::update(long long index, mpz_class delta){
+	long long ticket = log.append(index,delta);
+	wake();
+	return ticket;
+}
+
+long long commitment_state::update(vector<pair<long long, mpz_class> >& block){
+	long long ticket = 0;
+	for(auto& u : block)
+		ticket = log.append(u.first,u.second);
+	wake();
+	return ticket;
+}
+
+void commitment_state::track(long long index){
+	{
+		lock_guard<mutex> l(m);
+		pending_tracks.push_back(index);
+	}
+	queued.notify_one();
+}
+
+bool commitment_state::wait(long long ticket){
+	unique_lock<mutex> l(m);
+	applied.wait(l,[&]{ return applied_ticket>=ticket || !good.load(); });
+	return applied_ticket>=ticket;
+}
+
+bool commitment_state::flush(){
+	long long ticket = log.appended();
+	unique_lock<mutex> l(m);
+	applied.wait(l,[&]{ return (applied_ticket>=ticket || !good.load()) && !busy && pending_tracks.empty(); });
+	return applied_ticket>=ticket && good.load();
+}
+
+//each drain of the log becomes one version. tickets of concurrent appends can reach the log out of order, so
+//the applied ones above a gap wait in ahead until it closes
+void commitment_state::writer(){
+	vector<update_record*> records;
+	vector<long long> tracks;
+	set<long long> ahead;
+	long long done = 0;
+	for(;;){
+		log.drain(records,STATE_DRAIN_MAX);
+		{
+			lock_guard<mutex> l(m);
+			tracks.swap(pending_tracks);
+			busy = !tracks.empty();
+		}
+		if(records.empty() && tracks.empty()){
+			unique_lock<mutex> l(m);
+			sleeping.store(true);
+			queued.wait(l,[&]{ return stop || !log.empty() || !pending_tracks.empty(); });
+			sleeping.store(false);
+			if(stop && log.empty() && pending_tracks.empty())
+				return;
+			continue;
+		}
+
+		//write-ahead: a record is on disk before any reader can see it applied. a drain that is not logged is
+		//dropped, and so is everything after it, since replay could not get past the gap
+		if(good.load() && wal!=NULL && !wal->append(current.load()->seq+1,records)){
+			cerr<<"commitment_state: log write failed, updates are no longer applied"<<endl;
+			lock_guard<mutex> l(m);
+			good.store(false);
+		}
+		if(good.load() && !apply(records,tracks)){
+			cerr<<"commitment_state: cannot read keys, updates are no longer applied"<<endl;
+			lock_guard<mutex> l(m);
+			good.store(false);
+		}
+		if(good.load()){
+			for(update_record* r : records)
+				ahead.insert(r->ticket);
+		}
+
+		for(update_record* r : records)
+			delete r;
+		while(!ahead.empty() && *ahead.begin()==done+1){
+			ahead.erase(ahead.begin());
+			done++;
+		}
+		{
+			lock_guard<mutex> l(m);
+			applied_ticket = done;
+			busy = false;
+		}
+		applied.notify_all();
+		records.clear();
+		tracks.clear();
+	}
+}
+
+//deltas to the same index are summed first, then the update keys of the distinct indices are read in one batch
+//and applied to the digest and all tracked proofs with one batched call each
+bool commitment_state::apply(vector<update_record*>& records, vector<long long>& tracks){
+	TRACE_SPAN_ARG("state_apply", records.size());
+	state_version* old = current.load();
+
+	map<long long, mpz_class> sum;
+	for(update_record* r : records)
+		sum[r->index] += r->delta;
+	vector<long long> index;
+	vector<mpz_class> delta;
+	for(auto& e : sum){
+		if(e.second!=0){
+			index.push_back(e.first);
+			delta.push_back(e.second);
+		}
+	}
+	vector<vector<Ec1> > upks = a.calc_update_key_batch(index,prk);
+	for(auto& upk : upks){
+		if(upk.empty())
+			return false;
+	}
+
+	state_version* v = new state_version(*old);
+	build++;
+	v->digest = a.update_digest_batch(v->digest,index,delta,upks);
+	for(size_t k=0;k<index.size();k++)
+		add_value(v,index[k],delta[k]);
+	v->seq += records.size();
+
+	//the proof map is rebuilt whole; it holds the few indices a node serves, not the vector. a track whose proof
+	//cannot be read is dropped, the version is still published
+	bool read = true;
+	if((!old->proofs->empty() && !index.empty()) || !tracks.empty()){
+		vector<long long> tracked;
+		vector<vector<Ec1> > proofs;
+		for(auto& e : *old->proofs){
+			tracked.push_back(e.first);
+			proofs.push_back(e.second);
+		}
+		if(!index.empty())
+			a.update_proofs_batch(proofs,tracked,index,delta,upks);
+
+		v->proofs = new map<long long, vector<Ec1> >;
+		for(size_t k=0;k<tracked.size();k++)
+			(*v->proofs)[tracked[k]].swap(proofs[k]);
+
+		sparse_vector vals;
+		for(long long i : tracks){
+			if(v->proofs->count(i))
+				continue;
+			if(vals.entries.empty()){
+				vector<pair<long long, const mpz_class*> > entries;
+				collect(v->root,0,0,entries);
+				for(auto& e : entries)
+					vals.entries.insert(vals.entries.end(),make_pair(e.first,*e.second));
+			}
+			vector<Ec1> proof = a.prove(i,vals,prk);
+			if(proof.empty())
+				read = false;
+			else
+				(*v->proofs)[i].swap(proof);
+		}
+		ebr.retire(old->proofs,delete_proofs);
+	}
+
+	current.store(v);
+	ebr.retire(old,delete_version);
+	ebr.reclaim();
+	return read;
+}
+
+//nodes of older versions are copied and retired, nodes born in this build are changed in place
+void commitment_state::add_value(state_version* v, long long index, const mpz_class& delta){
+	void** slot = &v->root;
+	for(int d=0;d<levels;d++){
+		bool leaf = d==levels-1;
+		value_node* node = (value_node*)*slot;
+		if(node==NULL){
+			if(leaf){
+				node = new value_leaf;
+				mem_add(MEM_STATE,sizeof(value_leaf));
+			}else{
+				value_inner* n = new value_inner;
+				fill(n->child,n->child+STATE_FANOUT,(void*)NULL);
+				node = n;
+				mem_add(MEM_STATE,sizeof(value_inner));
+			}
+			node->born = build;
+		}else if(node->born!=build){
+			if(leaf){
+				node = new value_leaf(*(value_leaf*)*slot);
+				ebr.retire(*slot,delete_leaf);
+				mem_add(MEM_STATE,sizeof(value_leaf));
+			}else{
+				node = new value_inner(*(value_inner*)*slot);
+				ebr.retire(*slot,delete_inner);
+				mem_add(MEM_STATE,sizeof(value_inner));
+			}
+			node->born = build;
+		}
+		*slot = node;
+
+		if(leaf)
+			((value_leaf*)node)->v[digit(index,d,levels)] += delta;
+		else
+			slot = &((value_inner*)node)->child[digit(index,d,levels)];
+	}
+}
+
+//non-zero values in index order; the pointers stay valid as long as the version of root is pinned
+void commitment_state::collect(void* node, int depth, long long prefix, vector<pair<long long, const mpz_class*> >& out) const{
+	if(node==NULL)
+		return;
+	for(int i=0;i<STATE_FANOUT;i++){
+		long long index = (prefix<<STATE_FANOUT_BITS) | i;
+		if(depth==levels-1){
+			const mpz_class& x = ((value_leaf*)node)->v[i];
+			if(x!=0)
+				out.push_back(make_pair(index,&x));
+		}else{
+			collect(((value_inner*)node)->child[i],depth+1,index,out);
+		}
+	}
+}
+
+//published nodes are never changed, so the snapshot is read while the writer goes on
+bool commitment_state::checkpoint(const string& filename, bool proofs){
+	TRACE_SPAN("state_checkpoint");
+	snapshot s = read();
+	vector<pair<long long, const mpz_class*> > entries;
+	collect(s.v->root,0,0,entries);
+	vector<checkpoint_value> values(entries.size());
+	for(size_t k=0;k<entries.size();k++)
+		checkpoint_encode_value(values[k],entries[k].first,*entries[k].second,a.p);
+
+	map<long long, vector<Ec1> > none;
+	if(!checkpoint_save(filename,a.L,s.seq(),s.digest(),values,proofs ? *s.v->proofs : none))
+		return false;
+	if(wal!=NULL)
+		wal->checkpointed(s.seq());
+	return true;
+}
+
+void commitment_state::free_tree(void* node, int depth){
+	if(node==NULL)
+		return;
+	if(depth==levels-1){
+		delete_leaf(node);
+		return;
+	}
+	for(int i=0;i<STATE_FANOUT;i++)
+		free_tree(((value_inner*)node)->child[i],depth+1);
+	delete_inner(node);
+}
+
+commitment_state::snapshot commitment_state::read(){
+	return snapshot(*this);
+}
+
+commitment_state::snapshot::snapshot(commitment_state& s) : guard(s.ebr), v(s.current.load()), levels(s.levels) {}
+
+long long commitment_state::snapshot::seq() const{
+	return v->seq;
+}
+
+Ec1 commitment_state::snapshot::digest() const{
+	return v->digest;
+}
+
+mpz_class commitment_state::snapshot::value(long long index) const{
+	void* node = v->root;
+	for(int d=0;d<levels;d++){
+		if(node==NULL)
+			return 0;
+		if(d==levels-1)
+			return ((value_leaf*)node)->v[digit(index,d,levels)];
+		node = ((value_inner*)node)->child[digit(index,d,levels)];
+	}
+	return 0;
+}
+
+bool commitment_state::snapshot::proof(long long index, vector<Ec1>& out) const{
+	auto it = v->proofs->find(index);
+	if(it==v->proofs->end())
+		return false;
+	out = it->second;
+	return true;
+}
@@ -0,0 +1,109 @@
+#ifndef COMMITMENT_STATE_H
+#define COMMITMENT_STATE_H
+
+#include "vcs.h"
+#include "ebr.h"
+#include "update_log.h"
+#include "checkpoint.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+#define STATE_FANOUT_BITS 6
+#define STATE_FANOUT (1<<STATE_FANOUT_BITS)
+#define STATE_DRAIN_MAX 4096 //log records applied in one version at most
+
+//one published state of the vector, never changed once readers can see it. values live in a tree of
+//STATE_FANOUT-way nodes, shared between versions except on the paths of updated indices.
+struct state_version{
+	long long seq; //log records applied
+	Ec1 digest;
+	void* root; //NULL subtrees are all zero
+	map<long long, vector<Ec1> >* proofs; //of the tracked indices, against digest
+};
+
+//owns the vector, its digest and the proofs of tracked indices. producers append updates to an update_log without
+//locks; a writer thread, the only caller of a while the engine runs, drains it and applies each drain as one
+//version. readers take snapshots that stay consistent and valid while the writer publishes newer versions, and
+//never wait for it.
+class commitment_state{
+	public:
+	//commits to vals with setup; a, prk and vrk must outlive the engine. with a wal prefix every drain is written to
+	//an update_wal before it is applied, and with sync it is on disk before wait returns. the log starts empty, so
+	//only a checkpoint taken afterwards can be recovered from. ok() is false if setup cannot read the keys
+	commitment_state(vcs& a, vector<vector<Ec1> >& prk, vector<Ec2>& vrk, sparse_vector& vals, const string& wal = "", bool sync = false);
+	//restarts from a checkpoint and the records of wal after it, without setup or prove, then keeps logging to wal.
+	//on failure ok() is false and nothing is logged
+	commitment_state(vcs& a, vector<vector<Ec1> >& prk, vector<Ec2>& vrk, const string& checkpoint, const string& wal, bool sync = false);
+	~commitment_state(); //applies what is queued, then stops the writer
+	bool ok() const;
+
+	//saves the version of a snapshot, with the proofs of the tracked indices if proofs. any thread, the writer keeps
+	//applying meanwhile; log segments the checkpoint covers are deleted afterwards
+	bool checkpoint(const string& filename, bool proofs = true);
+
+	//any thread, lock-free. returns the ticket of the (last) update
+	long long update(long long index, mpz_class delta);
+	long long update(vector<pair<long long, mpz_class> >& block);
+	//keeps a proof of index from the next applied block on. if the keys for it cannot be read it stays untracked and
+	//ok() turns false
+	void track(long long index);
+	//waits until the updates with tickets up to ticket are visible to readers. false once a drain could not be
+	//logged or its keys read: it and every later one are dropped, and ok() turns false
+	bool wait(long long ticket);
+	//waits until everything queued so far, updates and tracks, is visible; false as for wait
+	bool flush();
+
+	class snapshot{
+		public:
+		long long seq() const;
+		Ec1 digest() const;
+		mpz_class value(long long index) const;
+		//false if index was not tracked yet in this version
+		bool proof(long long index, vector<Ec1>& out) const;
+
+		private:
+		friend class commitment_state;
+		snapshot(commitment_state& s);
+		epoch_guard guard; //before v: the epoch is pinned before the version is loaded
+		const state_version* v;
+		int levels;
+	};
+	//must not outlive the engine
+	snapshot read();
+
+	private:
+	vcs& a;
+	vector<vector<Ec1> >& prk;
+	vector<Ec2>& vrk;
+	int levels;
+
+	epoch_manager ebr;
+	atomic<state_version*> current;
+	long long build; //nodes born in the version being built are changed in place
+
+	update_log log;
+	update_wal* wal; //NULL without a log
+	atomic<bool> good; //false after a failed start, log write or key read, the writer then drops what it drains
+	atomic<bool> sleeping; //the writer waits on queued, producers have to wake it
+
+	mutex m;
+	condition_variable queued, applied;
+	vector<long long> pending_tracks;
+	long long applied_ticket; //every ticket up to it is applied
+	bool stop, busy;
+	thread th;
+
+	void init(state_version* v);
+	void wake();
+	void writer();
+	bool apply(vector<update_record*>& records, vector<long long>& tracks); //false if keys cannot be read
+	void add_value(state_version* v, long long index, const mpz_class& delta);
+	void collect(void* node, int depth, long long prefix, vector<pair<long long, const mpz_class*> >& out) const;
+	void free_tree(void* node, int depth);
+};
+
+#endif
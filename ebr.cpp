@@ -0,0 +1,70 @@
+#include "ebr.h"
+
+#include <thread>
+#include <functional>
+
+epoch_manager::epoch_manager(){
+	epoch.store(1);
+	for(int i=0;i<EBR_SLOTS;i++){
+		slots[i].pinned.store(0);
+		slots[i].used.store(false);
+	}
+}
+
+epoch_manager::~epoch_manager(){
+	for(size_t i=0;i<retired.size();i++)
+		retired[i].del(retired[i].p);
+}
+
+int epoch_manager::enter(){
+	//threads start looking at different slots, so claiming one rarely contends
+	int start = hash<thread::id>()(this_thread::get_id()) % EBR_SLOTS;
+	for(;;){
+		for(int k=0;k<EBR_SLOTS;k++){
+			int i = (start+k) % EBR_SLOTS;
+			bool expected = false;
+			if(!slots[i].used.load(memory_order_relaxed) && slots[i].used.compare_exchange_strong(expected, true)){
+				//seq_cst: the writer either sees this pin or the reader sees what the writer published before scanning
+				slots[i].pinned.store(epoch.load());
+				return i;
+			}
+		}
+		this_thread::yield();
+	}
+}
+
+void epoch_manager::exit(int slot){
+	slots[slot].pinned.store(0, memory_order_release);
+	slots[slot].used.store(false, memory_order_release);
+}
+
+void epoch_manager::retire(void* p, void (*del)(void*)){
+	retired_object r = {epoch.load(), p, del};
+	retired.push_back(r);
+}
+
+//an object retired in epoch e can only be held by readers pinned at e or before; once every pinned reader is
+//past e it is unreachable
+void epoch_manager::reclaim(){
+	epoch.fetch_add(1);
+
+	unsigned long long oldest = epoch.load();
+	for(int i=0;i<EBR_SLOTS;i++){
+		unsigned long long e = slots[i].pinned.load();
+		if(e!=0 && e<oldest)
+			oldest = e;
+	}
+
+	size_t kept = 0;
+	for(size_t i=0;i<retired.size();i++){
+		if(retired[i].epoch<oldest)
+			retired[i].del(retired[i].p);
+		else
+			retired[kept++] = retired[i];
+	}
+	retired.resize(kept);
+}
+
+size_t epoch_manager::pending() const{
+	return retired.size();
+}
@@ -0,0 +1,64 @@
+#ifndef EBR_H
+#define EBR_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+#define EBR_SLOTS 128 //readers inside a critical section at the same time, more wait for a free slot
+
+//epoch-based reclamation for one writer and many readers. a reader pins the current epoch in a slot while it
+//uses shared objects, which costs one CAS and two stores and never waits for the writer. the writer retires
+//objects it unlinked; they are deleted once every reader that could have seen them has left.
+class epoch_manager{
+	public:
+	epoch_manager();
+	~epoch_manager(); //deletes everything still retired, no reader may be inside
+
+	int enter(); //returns the slot to pass to exit
+	void exit(int slot);
+
+	//writer only
+	void retire(void* p, void (*del)(void*));
+	void reclaim();
+	size_t pending() const;
+
+	private:
+	struct retired_object{
+		unsigned long long epoch;
+		void* p;
+		void (*del)(void*);
+	};
+
+	struct alignas(64) slot{
+		atomic<unsigned long long> pinned; //epoch of the reader in the slot, 0 if none
+		atomic<bool> used;
+	};
+
+	atomic<unsigned long long> epoch;
+	slot slots[EBR_SLOTS];
+	vector<retired_object> retired;
+};
+
+//pins the epoch for the lifetime of the guard
+class epoch_guard{
+	public:
+	epoch_guard(epoch_manager& m) : m(&m), slot(m.enter()) {}
+	~epoch_guard(){
+		if(m!=NULL)
+			m->exit(slot);
+	}
+	epoch_guard(epoch_guard&& g) : m(g.m), slot(g.slot) {
+		g.m = NULL;
+	}
+
+	private:
+	epoch_guard(const epoch_guard&);
+	epoch_guard& operator=(const epoch_guard&);
+	epoch_manager* m;
+	int slot;
+};
+
+#endif
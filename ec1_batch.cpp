@@ -0,0 +1,88 @@
+#include "ec1_batch.h"
+#include "stats.h"
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+void ec1_add_batch_avx2(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n, unsigned char* special);
+void ec1_add_batch_avx512(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n, unsigned char* special);
+
+typedef void (*batch_fn)(uint64_t*, const uint64_t*, const uint64_t*, size_t, unsigned char*);
+
+//2^256 mod q, the raw form of Fp(1) in Montgomery representation
+static const uint64_t fp_mont_one[4] = {0x15ffffffffffff8eULL, 0xb939ffffffffff8aULL, 0xa2c62effffffffcdULL, 0x212ba4f27ffffff5ULL};
+
+//compares the lanes with Ec1 operators on a few points of the generator, including a short chunk
+static bool self_test(batch_fn fn){
+	const Ec1 g1(Fp(-1),Fp(1));
+	Ec1 a[3], b[3], r[3];
+	unsigned char special[3];
+	
+	a[0] = g1;
+	b[0] = g1+g1;
+	a[1] = b[0];
+	b[1] = a[1]+g1;
+	a[2] = b[1];
+	b[2] = b[1]+b[0];
+	
+	fn((uint64_t*)r,(const uint64_t*)a,(const uint64_t*)b,3,special);
+	for(int i=0;i<3;i++){
+		if(special[i] || r[i]!=a[i]+b[i])
+			return false;
+	}
+	return true;
+}
+
+struct batch_backend{
+	batch_fn fn;
+	const char* name;
+	
+	batch_backend(){
+		fn = NULL;
+		name = "scalar";
+		
+		Fp one(1);
+		if(sizeof(Fp)!=sizeof(fp_mont_one) || sizeof(Ec1)!=3*sizeof(Fp) || memcmp(&one,fp_mont_one,sizeof(fp_mont_one))!=0)
+			return;
+		
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx512f") && self_test(ec1_add_batch_avx512)){
+			fn = ec1_add_batch_avx512;
+			name = "avx512";
+		}
+		else if(__builtin_cpu_supports("avx2") && self_test(ec1_add_batch_avx2)){
+			fn = ec1_add_batch_avx2;
+			name = "avx2";
+		}
+	}
+};
+
+static const batch_backend& backend(){
+	static batch_backend b; //after Param::init, which precedes any point arithmetic
+	return b;
+}
+
+const char* ec1_batch_backend(){
+	return backend().name;
+}
+
+void ec1_add_batch(Ec1* r, const Ec1* a, const Ec1* b, size_t n){
+	const batch_backend& be = backend();
+	STAT_ADD(STAT_POINT_ADDS, n);
+	
+	if(be.fn==NULL){
+		for(size_t i=0;i<n;i++)
+			r[i] = a[i]+b[i];
+		return;
+	}
+	
+	vector<unsigned char> special(n);
+	be.fn((uint64_t*)r,(const uint64_t*)a,(const uint64_t*)b,n,special.data());
+	for(size_t i=0;i<n;i++){
+		if(special[i])
+			r[i] = a[i]+b[i];
+	}
+}
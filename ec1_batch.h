@@ -0,0 +1,30 @@
+#ifndef EC1_BATCH_H
+#define EC1_BATCH_H
+
+#include <cstddef>
+#include "bn.h"
+#include "stats.h"
+
+using namespace bn;
+
+//n independent additions r[i] = a[i] + b[i], r may alias a or b.
+//with AVX-512 or AVX2 the additions run 8 or 4 at a time in vector lanes (ec1_batch_impl.h); otherwise, or
+//when Fp is not in the 4x64-bit Montgomery form the lanes expect, they run one by one with Ec1 operators.
+//infinity and doubling lanes always take the scalar path.
+void ec1_add_batch(Ec1* r, const Ec1* a, const Ec1* b, size_t n);
+
+//single additions and subtractions outside ec1_mul and ec1_add_batch go through these, so -DVCS_STATS counts
+//them in STAT_POINT_ADDS too
+inline Ec1 ec1_add(const Ec1& a, const Ec1& b){
+	STAT_ADD(STAT_POINT_ADDS, 1);
+	return a+b;
+}
+inline Ec1 ec1_sub(const Ec1& a, const Ec1& b){
+	STAT_ADD(STAT_POINT_ADDS, 1);
+	return a-b;
+}
+
+//"avx512", "avx2" or "scalar"
+const char* ec1_batch_backend();
+
+#endif
@@ -0,0 +1,23 @@
+//built with -mavx2, only called after a runtime check (see ec1_batch.cpp)
+#include <immintrin.h>
+#include "ec1_batch_impl.h"
+
+struct lanes_avx2{
+	typedef __m256i V;
+	enum{ W = 4 };
+	static inline V load(const uint64_t* p){ return _mm256_loadu_si256((const __m256i*)p); }
+	static inline void store(uint64_t* p, V x){ _mm256_storeu_si256((__m256i*)p,x); }
+	static inline V set1(uint64_t x){ return _mm256_set1_epi64x(x); }
+	static inline V add(V a, V b){ return _mm256_add_epi64(a,b); }
+	static inline V sub(V a, V b){ return _mm256_sub_epi64(a,b); }
+	static inline V mul(V a, V b){ return _mm256_mul_epu32(a,b); }
+	static inline V and_(V a, V b){ return _mm256_and_si256(a,b); }
+	static inline V or_(V a, V b){ return _mm256_or_si256(a,b); }
+	static inline V andnot(V a, V b){ return _mm256_andnot_si256(a,b); }
+	template< int s > static inline V srl(V a){ return _mm256_srli_epi64(a,s); }
+	template< int s > static inline V sll(V a){ return _mm256_slli_epi64(a,s); }
+};
+
+void ec1_add_batch_avx2(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n, unsigned char* special){
+	ec1_batch_kernel<lanes_avx2>::run(r,a,b,n,special);
+}
@@ -0,0 +1,23 @@
+//built with -mavx512f, only called after a runtime check (see ec1_batch.cpp)
+#include <immintrin.h>
+#include "ec1_batch_impl.h"
+
+struct lanes_avx512{
+	typedef __m512i V;
+	enum{ W = 8 };
+	static inline V load(const uint64_t* p){ return _mm512_loadu_si512((const void*)p); }
+	static inline void store(uint64_t* p, V x){ _mm512_storeu_si512((void*)p,x); }
+	static inline V set1(uint64_t x){ return _mm512_set1_epi64(x); }
+	static inline V add(V a, V b){ return _mm512_add_epi64(a,b); }
+	static inline V sub(V a, V b){ return _mm512_sub_epi64(a,b); }
+	static inline V mul(V a, V b){ return _mm512_mul_epu32(a,b); }
+	static inline V and_(V a, V b){ return _mm512_and_si512(a,b); }
+	static inline V or_(V a, V b){ return _mm512_or_si512(a,b); }
+	static inline V andnot(V a, V b){ return _mm512_andnot_si512(a,b); }
+	template< int s > static inline V srl(V a){ return _mm512_srli_epi64(a,s); }
+	template< int s > static inline V sll(V a){ return _mm512_slli_epi64(a,s); }
+};
+
+void ec1_add_batch_avx512(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n, unsigned char* special){
+	ec1_batch_kernel<lanes_avx512>::run(r,a,b,n,special);
+}
@@ -0,0 +1,206 @@
+#ifndef EC1_BATCH_IMPL_H
+#define EC1_BATCH_IMPL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+//lane-generic part of ec1_add_batch, included by the per-ISA files with a lane type T providing
+//V, W, load, store, set1, add, sub, mul (low 32 x low 32 bits), and_, or_, andnot (~a&b), srl<s> and sll<s>.
+//a field element is 9 limbs of 29 bits in lanes of 64 bits and holds the same integer as the 4x64-bit
+//Montgomery form of Fp (R = 2^256), so points convert by repacking bits only. values are kept fully reduced.
+
+#define FB_LIMBS 9
+#define FB_BITS 29
+#define FB_MASK ((1ULL<<FB_BITS)-1)
+#define FB_QINV 395589093ULL //-q^-1 mod 2^29
+
+static const uint64_t fb_q[FB_LIMBS] = {19, 402653184, 1257, 33554432, 34322, 113246208, 452817, 273154048, 2433892};
+
+template< class T >
+struct ec1_batch_kernel{
+	typedef typename T::V V;
+
+	//x - y with borrow propagation into d, returns all-ones lanes where x < y
+	static V sub_borrow(V* d, const V* x, const V* y){
+		V mask = T::set1(FB_MASK), borrow = T::set1(0);
+		for(int i=0;i<FB_LIMBS;i++){
+			V t = T::sub(T::sub(x[i],y[i]),borrow);
+			borrow = T::template srl<63>(t);
+			d[i] = T::and_(t,mask);
+		}
+		return T::sub(T::set1(0),borrow);
+	}
+
+	//x normalized and < 2q, returns x mod q
+	static void reduce_once(V* x){
+		V q[FB_LIMBS], d[FB_LIMBS];
+		for(int i=0;i<FB_LIMBS;i++)
+			q[i] = T::set1(fb_q[i]);
+		V lt = sub_borrow(d,x,q);
+		for(int i=0;i<FB_LIMBS;i++)
+			x[i] = T::or_(T::and_(lt,x[i]),T::andnot(lt,d[i]));
+	}
+
+	static void add(V* r, const V* a, const V* b){
+		V mask = T::set1(FB_MASK), carry = T::set1(0);
+		for(int i=0;i<FB_LIMBS;i++){
+			V t = T::add(T::add(a[i],b[i]),carry);
+			carry = T::template srl<FB_BITS>(t);
+			r[i] = T::and_(t,mask);
+		}
+		reduce_once(r);
+	}
+
+	static void sub(V* r, const V* a, const V* b){ //a + (q - b)
+		V q[FB_LIMBS], nb[FB_LIMBS];
+		for(int i=0;i<FB_LIMBS;i++)
+			q[i] = T::set1(fb_q[i]);
+		sub_borrow(nb,q,b);
+		add(r,a,nb);
+	}
+
+	//Montgomery product a*b/2^256: eight reduction steps of 29 bits and a last one of 24 bits.
+	//columns stay below 18*2^58 + carries < 2^63
+	static void mul(V* r, const V* a, const V* b){
+		V t[2*FB_LIMBS];
+		V mask = T::set1(FB_MASK), mask24 = T::set1((1ULL<<24)-1), qinv = T::set1(FB_QINV), q[FB_LIMBS];
+		for(int i=0;i<FB_LIMBS;i++)
+			q[i] = T::set1(fb_q[i]);
+
+		for(int i=0;i<2*FB_LIMBS;i++)
+			t[i] = T::set1(0);
+		for(int i=0;i<FB_LIMBS;i++)
+			for(int j=0;j<FB_LIMBS;j++)
+				t[i+j] = T::add(t[i+j],T::mul(a[i],b[j]));
+
+		for(int i=0;i<8;i++){
+			V m = T::and_(T::mul(t[i],qinv),mask);
+			for(int j=0;j<FB_LIMBS;j++)
+				t[i+j] = T::add(t[i+j],T::mul(m,q[j]));
+			t[i+1] = T::add(t[i+1],T::template srl<FB_BITS>(t[i]));
+		}
+		V m = T::and_(T::mul(t[8],qinv),mask24);
+		for(int j=0;j<FB_LIMBS;j++)
+			t[8+j] = T::add(t[8+j],T::mul(m,q[j]));
+
+		for(int i=8;i<2*FB_LIMBS-1;i++){
+			t[i+1] = T::add(t[i+1],T::template srl<FB_BITS>(t[i]));
+			t[i] = T::and_(t[i],mask);
+		}
+		//the low 24 bits of t[8] are now zero, shift them out
+		for(int i=0;i<FB_LIMBS;i++)
+			r[i] = T::or_(T::template srl<24>(t[8+i]),T::and_(T::template sll<FB_BITS-24>(t[9+i]),mask));
+		reduce_once(r);
+	}
+
+	//Jacobian addition (add-2007-bl with Z3 = 2*Z1*Z2*H), x = {X,Y,Z}. does not handle
+	//infinity or a == +-b, those lanes are reported through special
+	static void point_add(V* r, const V* a, const V* b, V* h){
+		const V *X1 = a, *Y1 = a+FB_LIMBS, *Z1 = a+2*FB_LIMBS, *X2 = b, *Y2 = b+FB_LIMBS, *Z2 = b+2*FB_LIMBS;
+		V Z1Z1[FB_LIMBS], Z2Z2[FB_LIMBS], U1[FB_LIMBS], U2[FB_LIMBS], S1[FB_LIMBS], S2[FB_LIMBS];
+		V I[FB_LIMBS], J[FB_LIMBS], rr[FB_LIMBS], Vv[FB_LIMBS], t[FB_LIMBS];
+
+		mul(Z1Z1,Z1,Z1);
+		mul(Z2Z2,Z2,Z2);
+		mul(U1,X1,Z2Z2);
+		mul(U2,X2,Z1Z1);
+		mul(t,Z2,Z2Z2);
+		mul(S1,Y1,t);
+		mul(t,Z1,Z1Z1);
+		mul(S2,Y2,t);
+		sub(h,U2,U1);
+		add(t,h,h);
+		mul(I,t,t);
+		mul(J,h,I);
+		sub(t,S2,S1);
+		add(rr,t,t);
+		mul(Vv,U1,I);
+
+		V* X3 = r, *Y3 = r+FB_LIMBS, *Z3 = r+2*FB_LIMBS;
+		mul(X3,rr,rr);
+		sub(X3,X3,J);
+		sub(X3,X3,Vv);
+		sub(X3,X3,Vv);
+
+		sub(t,Vv,X3);
+		mul(Y3,rr,t);
+		mul(t,S1,J);
+		add(t,t,t);
+		sub(Y3,Y3,t);
+
+		mul(t,Z1,Z2);
+		add(t,t,t);
+		mul(Z3,t,h);
+	}
+
+	//4x64-bit limbs <-> 9x29-bit limbs, one lane
+	static void unpack(uint64_t* out, size_t stride, const uint64_t* in){
+		for(int i=0;i<FB_LIMBS;i++){
+			int bit = i*FB_BITS, w = bit/64, s = bit%64;
+			uint64_t x = in[w]>>s;
+			if(s+FB_BITS>64 && w<3)
+				x |= in[w+1]<<(64-s);
+			out[i*stride] = x & FB_MASK;
+		}
+	}
+
+	static void pack(uint64_t* out, const uint64_t* in, size_t stride){
+		memset(out,0,4*sizeof(uint64_t));
+		for(int i=0;i<FB_LIMBS;i++){
+			int bit = i*FB_BITS, w = bit/64, s = bit%64;
+			out[w] |= in[i*stride]<<s;
+			if(s+FB_BITS>64 && w<3)
+				out[w+1] |= in[i*stride]>>(64-s);
+		}
+	}
+
+	//r[i] = a[i] + b[i] on raw points of 12 limbs (X,Y,Z). lanes with special[i] set are left untouched.
+	//r may alias a or b
+	static void run(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n, unsigned char* special){
+		const int W = T::W;
+		uint64_t buf[3*FB_LIMBS][W];
+		V va[3*FB_LIMBS], vb[3*FB_LIMBS], vr[3*FB_LIMBS], h[FB_LIMBS];
+
+		for(size_t k=0;k<n;k+=W){
+			int lanes = n-k<(size_t)W ? n-k : W;
+
+			for(int side=0;side<2;side++){
+				const uint64_t* src = side ? b : a;
+				V* dst = side ? vb : va;
+				for(int l=0;l<W;l++){
+					const uint64_t* pt = src+12*(k+(l<lanes ? l : 0)); //short chunk: repeat the first lane
+					for(int c=0;c<3;c++)
+						unpack(&buf[c*FB_LIMBS][l],W,pt+4*c);
+				}
+				for(int i=0;i<3*FB_LIMBS;i++)
+					dst[i] = T::load(buf[i]);
+			}
+
+			point_add(vr,va,vb,h);
+
+			uint64_t hz[FB_LIMBS][W];
+			for(int i=0;i<FB_LIMBS;i++)
+				T::store(hz[i],h[i]);
+			for(int i=0;i<3*FB_LIMBS;i++)
+				T::store(buf[i],vr[i]);
+
+			for(int l=0;l<lanes;l++){
+				uint64_t z1 = 0, z2 = 0, hh = 0;
+				for(int i=0;i<4;i++){
+					z1 |= a[12*(k+l)+8+i];
+					z2 |= b[12*(k+l)+8+i];
+				}
+				for(int i=0;i<FB_LIMBS;i++)
+					hh |= hz[i][l];
+				special[k+l] = (z1==0 || z2==0 || hh==0);
+				if(special[k+l])
+					continue;
+				for(int c=0;c<3;c++)
+					pack(r+12*(k+l)+4*c,&buf[c*FB_LIMBS][l],W);
+			}
+		}
+	}
+};
+
+#endif
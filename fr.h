@@ -0,0 +1,57 @@
+#ifndef FR_H
+#define FR_H
+
+#include <gmp.h>
+#include <gmpxx.h>
+#include <cstring>
+
+//fixed-limb elements of Z_p, p is the group order used by vcs (254 bits).
+//unlike mpz_class they never touch the heap, so large arrays of them are cheap to allocate and to write to disk.
+
+#define FR_LIMBS (256/GMP_NUMB_BITS)
+
+struct fr_t{
+	mp_limb_t v[FR_LIMBS];
+};
+
+inline void fr_set(fr_t& z, const mpz_class& x){ //x must be in [0,p)
+	size_t count;
+	memset(z.v,0,sizeof(z.v));
+	mpz_export(z.v,&count,-1,sizeof(mp_limb_t),0,0,x.get_mpz_t());
+}
+
+inline void fr_set_ui(fr_t& z, unsigned long x){
+	memset(z.v,0,sizeof(z.v));
+	z.v[0] = x;
+}
+
+inline mpz_class fr_get(const fr_t& x){
+	mpz_class z;
+	mpz_import(z.get_mpz_t(),FR_LIMBS,-1,sizeof(mp_limb_t),0,0,x.v);
+	return z;
+}
+
+inline int fr_bits(const fr_t& x){
+	for(int i=FR_LIMBS-1;i>=0;i--){
+		if(x.v[i]!=0)
+			return i*GMP_NUMB_BITS + GMP_NUMB_BITS - __builtin_clzll(x.v[i]);
+	}
+	return 0;
+}
+
+inline bool fr_tstbit(const fr_t& x, int i){
+	return (x.v[i/GMP_NUMB_BITS] >> (i%GMP_NUMB_BITS)) & 1;
+}
+
+inline void fr_sub(fr_t& z, const fr_t& x, const fr_t& y, const fr_t& p){
+	if(mpn_sub_n(z.v,x.v,y.v,FR_LIMBS))
+		mpn_add_n(z.v,z.v,p.v,FR_LIMBS);
+}
+
+inline void fr_mul(fr_t& z, const fr_t& x, const fr_t& y, const fr_t& p){
+	mp_limb_t t[2*FR_LIMBS], q[FR_LIMBS+1];
+	mpn_mul_n(t,x.v,y.v,FR_LIMBS);
+	mpn_tdiv_qr(q,z.v,0,t,2*FR_LIMBS,p.v,FR_LIMBS);
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "glv.h"
+#include "stats.h"
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+//order of G1, same as vcs::p
+#define GLV_ORDER "16798108731015832284940804142231733909759579603404752749028378864165570215949"
+//cube roots of unity in Fp and Z_p, paired so that (beta*x,y) = lambda*(x,y)
+#define GLV_BETA "1807136345283977465813277102364620289631804529403213381639"
+#define GLV_LAMBDA "3614272690567954932015376758832191878923846166742621487126"
+//reduced basis (a1,b1), (a2,b2) of the lattice {(x,y) : x+y*lambda = 0 mod p}
+#define GLV_A1 "9295429630892703745"
+#define GLV_B1 "-129607518034317099886745702645398241283"
+#define GLV_A2 "129607518034317099896041132276290945028"
+#define GLV_B2 "9295429630892703745"
+
+#define GLV_TABLE (1<<(GLV_W-2))
+#define GLV_MAX_DIGITS 258
+
+struct glv_params{
+	mpz_class r, lambda, a1, b1, a2, b2;
+	Fp beta;
+	bool ok;
+	
+	glv_params():r(GLV_ORDER),lambda(GLV_LAMBDA),a1(GLV_A1),b1(GLV_B1),a2(GLV_A2),b2(GLV_B2),beta(GLV_BETA){
+		const Ec1 g1(Fp(-1),Fp(1)); //generator of CurveFp254BNb
+		Ec1 phi = g1;
+		phi.p[0] = phi.p[0]*beta;
+		const mie::Vuint l((lambda.get_str()).c_str());
+		ok = (phi==g1*l);
+	}
+};
+
+static const glv_params& glv(){
+	static glv_params params; //after Param::init, which precedes any point arithmetic
+	return params;
+}
+
+bool glv_enabled(){
+	return glv().ok;
+}
+
+
+//width-GLV_W non-adjacent form of 0 <= k < 2^256, LSB first, returns the number of digits
+static int wnaf(signed char* naf, const mpz_class& k){
+	uint64_t v[5];
+	size_t count;
+	memset(v,0,sizeof(v));
+	mpz_export(v,&count,-1,sizeof(uint64_t),0,0,k.get_mpz_t());
+	
+	int len = 0;
+	while(v[0]|v[1]|v[2]|v[3]|v[4]){
+		int d = 0;
+		if(v[0]&1){
+			d = v[0] & ((1<<GLV_W)-1);
+			if(d >= (1<<(GLV_W-1)))
+				d -= 1<<GLV_W;
+			
+			if(d>0)
+				v[0] -= d; //v and d agree on the low bits, no borrow
+			else{
+				v[0] += -d;
+				if(v[0] < (uint64_t)-d){
+					for(int i=1;i<5;i++)
+						if(++v[i]!=0)
+							break;
+				}
+			}
+		}
+		naf[len++] = d;
+		for(int i=0;i<4;i++)
+			v[i] = (v[i]>>1) | (v[i+1]<<63);
+		v[4] >>= 1;
+	}
+	return len;
+}
+
+//width-w non-adjacent form of a 64-bit magnitude, v <= 2^63 so v+2^(w-1) does not overflow
+static int wnaf64(signed char* naf, uint64_t v, int w){
+	int len = 0;
+	while(v){
+		int d = 0;
+		if(v&1){
+			d = v & ((1<<w)-1);
+			if(d >= (1<<(w-1)))
+				d -= 1<<w;
+			v -= d;
+		}
+		naf[len++] = d;
+		v >>= 1;
+	}
+	return len;
+}
+
+//t[i] = (2i+1)*P
+static void odd_multiples(Ec1* t, const Ec1& P, int n){
+	Ec1 P2;
+	Ec1::dbl(P2,P);
+	t[0] = P;
+	for(int i=1;i<n;i++)
+		Ec1::add(t[i],t[i-1],P2);
+	STAT_ADD(STAT_POINT_DBLS, 1);
+	STAT_ADD(STAT_POINT_ADDS, n-1);
+}
+
+static inline void add_digit(Ec1& R, const Ec1* t, int d){
+	if(d!=0)
+		STAT_ADD(STAT_POINT_ADDS, 1);
+	if(d>0)
+		Ec1::add(R,R,t[d>>1]);
+	else if(d<0){
+		Ec1 temp;
+		Ec1::neg(temp,t[(-d)>>1]);
+		Ec1::add(R,R,temp);
+	}
+}
+
+Ec1 ec1_mul(const Ec1& P, const mpz_class& k){
+	const glv_params& c = glv();
+	
+	mpz_class e = k;
+	bool negative = e<0;
+	if(negative)
+		e = -e;
+	if(e>=c.r)
+		e %= c.r;
+	
+	if(mpz_fits_slong_p(e.get_mpz_t()))
+		return ec1_mul_si(P, negative ? -mpz_get_si(e.get_mpz_t()) : mpz_get_si(e.get_mpz_t()));
+	
+	Ec1 R = P*0;
+	signed char naf1[GLV_MAX_DIGITS], naf2[GLV_MAX_DIGITS];
+	Ec1 t1[GLV_TABLE], t2[GLV_TABLE];
+	int len1, len2 = 0;
+	
+	if(!c.ok || mpz_sizeinbase(e.get_mpz_t(),2) <= GLV_MIN_BITS){
+		STAT_ADD(mpz_sizeinbase(e.get_mpz_t(),2) <= 128 ? STAT_MUL_128 : STAT_MUL_256, 1);
+		len1 = wnaf(naf1,e);
+		odd_multiples(t1,P,GLV_TABLE);
+	}
+	else{
+		STAT_ADD(STAT_MUL_256, 1);
+		//c1 = round(b2*e/r), c2 = round(-b1*e/r), both numerators are positive
+		mpz_class c1 = (2*c.b2*e + c.r)/(2*c.r), c2 = (-2*c.b1*e + c.r)/(2*c.r);
+		mpz_class k1 = e - c1*c.a1 - c2*c.a2, k2 = -c1*c.b1 - c2*c.b2;
+		bool s1 = k1<0, s2 = k2<0;
+		
+		Ec1 base = P;
+		if(s1)
+			Ec1::neg(base,P);
+		odd_multiples(t1,base,GLV_TABLE);
+		
+		//t2 = lambda*(+-P) multiples, from t1 by the endomorphism
+		for(int i=0;i<GLV_TABLE;i++){
+			t2[i] = t1[i];
+			t2[i].p[0] = t2[i].p[0]*c.beta;
+			if(s1!=s2)
+				Ec1::neg(t2[i],t2[i]);
+		}
+		
+		len1 = wnaf(naf1, s1 ? mpz_class(-k1) : k1);
+		len2 = wnaf(naf2, s2 ? mpz_class(-k2) : k2);
+	}
+	
+	STAT_ADD(STAT_POINT_DBLS, max(len1,len2));
+	for(int i=max(len1,len2)-1;i>=0;i--){
+		Ec1::dbl(R,R);
+		if(i<len1)
+			add_digit(R,t1,naf1[i]);
+		if(i<len2)
+			add_digit(R,t2,naf2[i]);
+	}
+	
+	if(negative)
+		Ec1::neg(R,R);
+	return R;
+}
+
+void ec1_table_init(ec1_table& table, const Ec1& P){
+	odd_multiples(table.t,P,1<<(GLV_TABLE_W-2));
+}
+
+static Ec1 mul_si(const Ec1* t, long long k, int w){
+	signed char naf[65];
+	uint64_t v = k<0 ? -(uint64_t)k : k;
+	int len = wnaf64(naf,v,w);
+	
+	STAT_ADD(STAT_MUL_64, 1);
+	STAT_ADD(STAT_POINT_DBLS, len);
+	Ec1 R = t[0]*0;
+	for(int i=len-1;i>=0;i--){
+		Ec1::dbl(R,R);
+		add_digit(R,t,naf[i]);
+	}
+	
+	if(k<0)
+		Ec1::neg(R,R);
+	return R;
+}
+
+Ec1 ec1_mul_si(const Ec1& P, long long k){
+	Ec1 t[GLV_TABLE];
+	//short scalars do not pay for a full table
+	int w = k>-(1<<16) && k<(1<<16) ? 3 : GLV_W;
+	odd_multiples(t,P,1<<(w-2));
+	return mul_si(t,k,w);
+}
+
+Ec1 ec1_mul_si(const ec1_table& table, long long k){
+	return mul_si(table.t,k,GLV_TABLE_W);
+}
@@ -0,0 +1,38 @@
+#ifndef GLV_H
+#define GLV_H
+
+#include <gmp.h>
+#include <gmpxx.h>
+#include "bn.h"
+
+using namespace std;
+using namespace bn;
+
+#define GLV_W 5 //wNAF width, tables hold 2^(GLV_W-2) odd multiples
+#define GLV_MIN_BITS 128 //shorter scalars are not split
+
+//variable-base scalar multiplication on G1, replaces Ec1*Vuint on the update and verify paths.
+//scalars longer than GLV_MIN_BITS are split as k = k1 + k2*lambda (mod p) with |k1|,|k2| < 2^127, using the
+//endomorphism (x,y) -> (beta*x,y) = lambda*(x,y) of BN254 G1, and both halves are walked together in wNAF.
+//shorter scalars (batch_verify randomizers, small deltas) skip the split and use plain wNAF.
+//k may be negative or >= p. the endomorphism is checked against lambda*g1 once; if the check fails the split is
+//never used.
+Ec1 ec1_mul(const Ec1& P, const mpz_class& k);
+
+bool glv_enabled();
+
+#define GLV_TABLE_W 6 //wNAF width used with an ec1_table
+
+//odd multiples P, 3P, 5P, ... of a point that is multiplied by many small scalars, e.g. one level of an update
+//key applied to many proofs
+struct ec1_table{
+	Ec1 t[1<<(GLV_TABLE_W-2)];
+};
+
+void ec1_table_init(ec1_table& table, const Ec1& P);
+
+//64-bit scalars: wNAF straight on the magnitude, no mpz. ec1_mul takes this path whenever k fits.
+Ec1 ec1_mul_si(const Ec1& P, long long k);
+Ec1 ec1_mul_si(const ec1_table& table, long long k);
+
+#endif
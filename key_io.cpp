@@ -0,0 +1,212 @@
+#include "key_io.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <fstream>
+
+static atomic<bool> direct(false);
+
+void set_direct_io(bool on){
+	direct.store(on);
+}
+
+bool direct_io(){
+	return direct.load(memory_order_relaxed);
+}
+
+int open_key_file(const string& filename){
+	if(direct_io()){
+		int fd = open(filename.c_str(), O_RDONLY | O_DIRECT);
+		if(fd>=0)
+			return fd;
+	}
+	return open(filename.c_str(), O_RDONLY);
+}
+
+//O_DIRECT needs aligned offsets, lengths and buffers: read the aligned span around the request and copy it out
+static long long direct_pread(int fd, void* buf, size_t len, long long offset){
+	long long start = offset & ~(long long)(DIRECT_ALIGN-1);
+	size_t span = (offset+len-start+DIRECT_ALIGN-1) & ~(size_t)(DIRECT_ALIGN-1);
+	void* bounce;
+	if(posix_memalign(&bounce, DIRECT_ALIGN, span)!=0)
+		return -1;
+	long long got = pread(fd, bounce, span, start) - (offset-start);
+	got = got<0 ? 0 : got>(long long)len ? len : got;
+	memcpy(buf, (char*)bounce+(offset-start), got);
+	free(bounce);
+	return got;
+}
+
+static long long key_pread(int fd, void* buf, size_t len, long long offset){
+	if(direct_io() && (fcntl(fd, F_GETFL) & O_DIRECT))
+		return direct_pread(fd, buf, len, offset);
+	return pread(fd, buf, len, offset);
+}
+
+void evict_file(const string& filename){
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd<0)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+long long process_read_bytes(){
+	ifstream in("/proc/self/io");
+	string key;
+	long long value;
+	while(in>>key>>value){
+		if(key=="read_bytes:")
+			return value;
+	}
+	return -1;
+}
+
+key_reader::key_reader(unsigned depth){
+	this->depth = depth;
+#ifdef VCS_IO_URING
+	//no io_uring (old kernel, seccomp): fall back to pread
+	ring_ok = io_uring_queue_init(depth, &ring, 0)==0;
+#endif
+}
+
+key_reader::~key_reader(){
+#ifdef VCS_IO_URING
+	if(ring_ok)
+		io_uring_queue_exit(&ring);
+#endif
+}
+
+void key_reader::read(int fd, long long offset, void* buf, size_t len, function<void()> done){
+	request r;
+	r.fd = fd;
+	r.offset = offset;
+	r.buf = buf;
+	r.len = len;
+	r.done = done;
+	queue.push_back(r);
+}
+
+//a short or failed asynchronous read is finished synchronously. false if the data is still not all there
+bool key_reader::complete(request& r, long long result){
+	size_t got = result>0 ? result : 0;
+	while(got<r.len){
+		long long n = key_pread(r.fd, (char*)r.buf+got, r.len-got, r.offset+got);
+		if(n<0 && errno==EINTR)
+			continue;
+		if(n<=0)
+			break;
+		got += n;
+	}
+	STAT_ADD(STAT_BYTES_READ, got);
+	if(got<r.len)
+		return false;
+	if(r.done)
+		r.done();
+	return true;
+}
+
+bool key_reader::submit(){
+	TRACE_SPAN_ARG("key_io.submit", queue.size());
+	bool ok = true;
+#ifdef VCS_IO_URING
+	if(ring_ok && !direct_io()){
+		size_t next = 0, inflight = 0;
+		while(next<queue.size() || inflight>0){
+			while(next<queue.size() && inflight<depth){
+				struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+				if(sqe==NULL)
+					break;
+				io_uring_prep_read(sqe, queue[next].fd, queue[next].buf, queue[next].len, queue[next].offset);
+				io_uring_sqe_set_data(sqe, (void*)next);
+				next++;
+				inflight++;
+			}
+			
+			io_uring_submit_and_wait(&ring, 1);
+			
+			struct io_uring_cqe* cqe;
+			while(inflight>0 && io_uring_peek_cqe(&ring, &cqe)==0){
+				size_t k = (size_t)io_uring_cqe_get_data(cqe);
+				long long result = cqe->res;
+				io_uring_cqe_seen(&ring, cqe);
+				inflight--;
+				ok = complete(queue[k], result) && ok;
+			}
+		}
+		queue.clear();
+		return ok;
+	}
+#endif
+	for(size_t k=0;k<queue.size();k++)
+		ok = complete(queue[k], key_pread(queue[k].fd, queue[k].buf, queue[k].len, queue[k].offset)) && ok;
+	queue.clear();
+	return ok;
+}
+
+key_reader& thread_reader(){
+	static thread_local key_reader reader;
+	return reader;
+}
+
+reader_pool::reader_pool(int nthreads){
+	stop = false;
+	for(int k=0;k<nthreads;k++)
+		threads.push_back(thread(&reader_pool::work, this));
+}
+
+reader_pool::~reader_pool(){
+	{
+		lock_guard<mutex> lock(m);
+		stop = true;
+	}
+	queued.notify_all();
+	for(size_t k=0;k<threads.size();k++)
+		threads[k].join();
+}
+
+void reader_pool::run(int n, function<void(int)> f){
+	if(n<=0)
+		return;
+	int left = n-1;
+	condition_variable done;
+	
+	unique_lock<mutex> lock(m);
+	for(int k=0;k<n-1;k++){
+		tasks.push_back([this, k, &f, &left, &done]{
+			f(k);
+			lock_guard<mutex> lock(m);
+			if(--left==0)
+				done.notify_one();
+		});
+	}
+	lock.unlock();
+	queued.notify_all();
+	
+	//the caller takes the last share, so a single share never changes threads
+	f(n-1);
+	
+	lock.lock();
+	done.wait(lock, [&left]{ return left==0; });
+}
+
+void reader_pool::work(){
+	unique_lock<mutex> lock(m);
+	while(true){
+		queued.wait(lock, [this]{ return stop || !tasks.empty(); });
+		if(tasks.empty())
+			return;
+		function<void()> task = move(tasks.front());
+		tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef KEY_IO_H
+#define KEY_IO_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef VCS_IO_URING
+#include <liburing.h>
+#endif
+
+using namespace std;
+
+//batches small positioned reads of key files. reads are queued with read() and all complete in submit(),
+//each running its callback once its data is in place. a read that fails or hits the end of the file does not run
+//its callback, and submit() returns false. with VCS_IO_URING the queued reads are issued through
+//io_uring, up to depth at a time, so the device sees many outstanding requests; otherwise they are plain preads.
+class key_reader{
+	public:
+	key_reader(unsigned depth = 256);
+	~key_reader();
+	
+	void read(int fd, long long offset, void* buf, size_t len, function<void()> done = function<void()>());
+	bool submit();
+	
+	private:
+	struct request{
+		int fd;
+		long long offset;
+		void* buf;
+		size_t len;
+		function<void()> done;
+	};
+	vector<request> queue;
+	unsigned depth;
+	
+	bool complete(request& r, long long result);
+	
+#ifdef VCS_IO_URING
+	struct io_uring ring;
+	bool ring_ok;
+#endif
+};
+
+//one reader per thread, so that an io_uring is set up once and not per call
+key_reader& thread_reader();
+
+//threads that live as long as the pool, so that batch reads do not start threads, and with them readers and
+//io_uring rings, on every call. run(n, f) calls f(0), ..., f(n-2) on the pool threads and f(n-1) on the
+//calling thread, and returns once all have returned. several threads may run at once; their calls share the
+//pool threads.
+class reader_pool{
+	public:
+	reader_pool(int nthreads);
+	~reader_pool();
+	
+	void run(int n, function<void(int)> f);
+	
+	private:
+	vector<thread> threads;
+	deque<function<void()> > tasks;
+	mutex m;
+	condition_variable queued;
+	bool stop;
+	
+	void work();
+};
+
+//with direct I/O on, key files are opened with O_DIRECT where the file system allows it and read through
+//page-aligned bounce buffers, so every read goes to the device whatever the page cache holds. io_uring is not
+//used meanwhile. meant for benchmarks of cold reads.
+#define DIRECT_ALIGN 4096
+void set_direct_io(bool on);
+bool direct_io();
+int open_key_file(const string& filename);
+
+//drops the pages of a file from the page cache
+void evict_file(const string& filename);
+//bytes this process had fetched from storage (read_bytes of /proc/self/io), -1 if not available
+long long process_read_bytes();
+
+#endif
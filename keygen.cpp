@@ -0,0 +1,78 @@
+#include "vcs.h"
+#include "trace.h"
+
+#include <iostream>
+#include <cstring>
+
+#include "test_point.hpp"
+#include "bn.h"
+
+#include <gmp.h>
+#include <gmpxx.h>
+
+using namespace std;
+using namespace bn;
+
+//multi-process key generation:
+//  ./keygen root [number] [k] [shard_path]   upper levels, vrk and root.txt, with 2^k shards (default k=3)
+//  ./keygen worker [number] [w] [nworkers]   shards w, w+nworkers, ... (run on any box that has pk.txt and root.txt)
+//  ./keygen merge [number] [nworkers]        validate all shards and drop root.txt
+//  ./keygen all [number] [k] [shard_path]    single-process keygen
+int main(int argc, char** argv){
+	if(argc<3){
+		cout<<"usage: "<<argv[0]<<" root|worker|merge|all [number] [w] [nworkers]"<<endl;
+		return 1;
+	}
+	
+	string mode = argv[1];
+#ifdef VCS_TRACE
+	trace_start();
+#endif
+	int L = atoi(argv[2]);
+
+	bn::CurveParam cp = bn::CurveFp254BNb;
+	Param::init(cp);
+	const Point& pt = selectPoint(cp);
+	const Ec2 g2(
+		Fp2(Fp(pt.g2.aa), Fp(pt.g2.ab)),
+		Fp2(Fp(pt.g2.ba), Fp(pt.g2.bb))
+	);
+	const Ec1 g1(pt.g1.a, pt.g1.b);
+	
+	mpz_class p;
+	p.set_str("16798108731015832284940804142231733909759579603404752749028378864165570215949",10);
+	
+	vcs a(L,p,g1,g2);
+	
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	
+	if((mode=="root" || mode=="all") && argc>=4 && !a.set_layout(atoi(argv[3]), argc>=5 ? argv[4] : ""))
+		return 1;
+	
+	if(mode=="root"){
+		if(!a.keygen_root(prk,vrk))
+			return 1;
+	}
+	else if(mode=="worker" && argc>=5 && atoi(argv[4])>0 && atoi(argv[3])>=0 && atoi(argv[3])<atoi(argv[4])){
+		if(!a.keygen_worker(atoi(argv[3]),atoi(argv[4])))
+			return 1;
+	}
+	else if(mode=="merge" && argc>=4 && atoi(argv[3])>0){
+		if(!a.keygen_merge(atoi(argv[3])))
+			return 1;
+	}
+	else if(mode=="all"){
+		if(!a.keygen(prk,vrk))
+			return 1;
+	}
+	else{
+		cout<<"usage: "<<argv[0]<<" root|worker|merge|all [number] [w] [nworkers]"<<endl;
+		return 1;
+	}
+	
+#ifdef VCS_TRACE
+	trace_dump("trace_keygen_"+mode+".json");
+#endif
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include "latency.h"
+
+#include <sstream>
+#include <mutex>
+#include <algorithm>
+
+const double latency_quantiles[4] = {50, 90, 99, 99.9};
+
+static int bucket(long long value){
+	if(value<HIST_SUB)
+		return value;
+	int shift = 63 - __builtin_clzll(value) - (HIST_SUB_BITS-1);
+	return shift*HIST_HALF + (value>>shift);
+}
+
+//largest value that falls into bucket i
+static long long bucket_top(int i){
+	if(i<HIST_SUB)
+		return i;
+	int shift = i/HIST_HALF - 1;
+	long long m = i%HIST_HALF + HIST_HALF;
+	return ((m+1)<<shift) - 1;
+}
+
+latency_histogram::latency_histogram(){
+	counts.resize(HIST_BUCKETS);
+	reset();
+}
+
+void latency_histogram::reset(){
+	fill(counts.begin(),counts.end(),0);
+	total = 0;
+	lo = hi = 0;
+	sum = 0;
+}
+
+void latency_histogram::record(long long value){
+	if(value<0)
+		value = 0;
+	counts[bucket(value)]++;
+	lo = total==0 || value<lo ? value : lo;
+	hi = value>hi ? value : hi;
+	total++;
+	sum += value;
+}
+
+void latency_histogram::merge(const latency_histogram& h){
+	if(h.total==0)
+		return;
+	for(int i=0;i<HIST_BUCKETS;i++)
+		counts[i] += h.counts[i];
+	lo = total==0 || h.lo<lo ? h.lo : lo;
+	hi = h.hi>hi ? h.hi : hi;
+	total += h.total;
+	sum += h.sum;
+}
+
+long long latency_histogram::count() const{
+	return total;
+}
+
+long long latency_histogram::min() const{
+	return lo;
+}
+
+long long latency_histogram::max() const{
+	return hi;
+}
+
+double latency_histogram::mean() const{
+	return total ? sum/total : 0;
+}
+
+long long latency_histogram::percentile(double q) const{
+	if(total==0)
+		return 0;
+	long long rank = (long long)(q/100*total + 0.5);
+	rank = rank<1 ? 1 : rank>total ? total : rank;
+
+	long long seen = 0;
+	for(int i=0;i<HIST_BUCKETS;i++){
+		seen += counts[i];
+		if(seen>=rank){
+			long long v = bucket_top(i);
+			return v<hi ? v : hi;
+		}
+	}
+	return hi;
+}
+
+string latency_histogram::summary() const{
+	stringstream out;
+	for(int i=0;i<4;i++)
+		out<<percentile(latency_quantiles[i])<<",";
+	out<<hi;
+	return out.str();
+}
+
+bool latency_regressed(const latency_histogram& base, const latency_histogram& cur, double threshold){
+	if(base.count()==0 || cur.count()==0)
+		return false;
+	return cur.percentile(50) > base.percentile(50)*(1+threshold)
+		|| cur.percentile(99) > base.percentile(99)*(1+threshold);
+}
+
+
+static const char* op_names[OP_COUNT] = {
+	"calc_update_key", "calc_update_key_batch", "setup", "prove", "verify", "batch_verify",
+	"prove_multi", "verify_multi", "update_digest", "update_proof", "update_digest_batch", "update_proofs_batch"
+};
+
+struct op_latency{
+	mutex m;
+	latency_histogram h;
+};
+
+static op_latency* ops(){
+	static op_latency o[OP_COUNT];
+	return o;
+}
+
+const char* vcs_op_name(int op){
+	return op>=0 && op<OP_COUNT ? op_names[op] : "unknown";
+}
+
+void vcs_latency_record(int op, long long ns){
+	lock_guard<mutex> lock(ops()[op].m);
+	ops()[op].h.record(ns);
+}
+
+latency_histogram vcs_latency(int op){
+	lock_guard<mutex> lock(ops()[op].m);
+	return ops()[op].h;
+}
+
+void vcs_latency_reset(){
+	for(int op=0;op<OP_COUNT;op++){
+		lock_guard<mutex> lock(ops()[op].m);
+		ops()[op].h.reset();
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+using namespace std;
+
+#define HIST_SUB_BITS 7 //64 (HIST_HALF) sub-buckets per power of two, values are kept within 1/64 (~1.6%)
+#define HIST_SUB (1<<HIST_SUB_BITS)
+#define HIST_HALF (HIST_SUB/2)
+#define HIST_BUCKETS ((64-HIST_SUB_BITS+1)*HIST_HALF)
+
+//HDR-style histogram of non-negative integer values (ns, us, ...): exact below HIST_SUB, above that the buckets of
+//every power of two are split into HIST_HALF equal parts, so memory is fixed and relative error bounded.
+class latency_histogram{
+	public:
+	latency_histogram();
+
+	void record(long long value);
+	void merge(const latency_histogram& h);
+	void reset();
+
+	long long count() const;
+	long long min() const;
+	long long max() const;
+	double mean() const;
+	//highest value equivalent to the one at quantile q (0..100), clipped to max
+	long long percentile(double q) const;
+
+	//"p50,p90,p99,p99.9,max"
+	string summary() const;
+
+	private:
+	vector<long long> counts;
+	long long total, lo, hi;
+	double sum;
+};
+
+//percentiles reported per operation
+extern const double latency_quantiles[4];
+
+//true if p50 or p99 of cur exceed those of base by more than threshold (0.1 = 10%)
+bool latency_regressed(const latency_histogram& base, const latency_histogram& cur, double threshold);
+
+
+//per-operation histograms (ns) recorded by vcs itself when built with -DVCS_LATENCY. recording takes the lock of the
+//operation once per call, so it stays out of the per-level loops.
+enum vcs_op{
+	OP_CALC_UPDATE_KEY,
+	OP_CALC_UPDATE_KEY_BATCH,
+	OP_SETUP,
+	OP_PROVE,
+	OP_VERIFY,
+	OP_BATCH_VERIFY,
+	OP_PROVE_MULTI,
+	OP_VERIFY_MULTI,
+	OP_UPDATE_DIGEST,
+	OP_UPDATE_PROOF,
+	OP_UPDATE_DIGEST_BATCH,
+	OP_UPDATE_PROOFS_BATCH,
+	OP_COUNT
+};
+
+const char* vcs_op_name(int op);
+void vcs_latency_record(int op, long long ns);
+//copy of the histogram of op, safe while other threads record
+latency_histogram vcs_latency(int op);
+void vcs_latency_reset();
+
+struct latency_scope{
+	int op;
+	chrono::steady_clock::time_point start;
+
+	latency_scope(int op){
+		this->op = op;
+		start = chrono::steady_clock::now();
+	}
+	~latency_scope(){
+		vcs_latency_record(op, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+	}
+};
+
+#ifdef VCS_LATENCY
+#define LATENCY_SCOPE(op) latency_scope latency_scope_(op)
+#else
+#define LATENCY_SCOPE(op)
+#endif
+
+#endif
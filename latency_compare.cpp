@@ -0,0 +1,71 @@
+#include "latency.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstdlib>
+
+using namespace std;
+
+//./latency_compare baseline current [threshold]
+//compares two outputs of ./test (e.g. results and a new run): every row "name,v1,v2,..." with at least MIN_VALUES
+//numbers is one operation. prints p50,p90,p99,p99.9,max of both and flags operations whose p50 or p99 grew by more
+//than threshold (default 0.1). exits with 1 if any operation regressed.
+
+#define MIN_VALUES 10
+
+static bool read_rows(const char* filename, map<string, latency_histogram>& ops){
+	ifstream in(filename);
+	if(!in){
+		cerr<<"cannot read "<<filename<<endl;
+		return false;
+	}
+
+	string line;
+	while(getline(in,line)){
+		stringstream ss(line);
+		string name, item;
+		getline(ss,name,',');
+
+		latency_histogram h;
+		bool numeric = true;
+		while(numeric && getline(ss,item,',')){
+			char* end;
+			long long v = strtoll(item.c_str(),&end,10);
+			numeric = !item.empty() && *end==0;
+			if(numeric)
+				h.record(v);
+		}
+		if(numeric && h.count()>=MIN_VALUES)
+			ops[name].merge(h);
+	}
+	return true;
+}
+
+int main(int argc, char** argv){
+	if(argc<3){
+		cerr<<"usage: "<<argv[0]<<" baseline current [threshold]"<<endl;
+		return 2;
+	}
+	double threshold = argc>3 ? atof(argv[3]) : 0.1;
+
+	map<string, latency_histogram> base, cur;
+	if(!read_rows(argv[1],base) || !read_rows(argv[2],cur))
+		return 2;
+
+	int regressions = 0;
+	cout<<"op,p50,p90,p99,p99.9,max,base_p50,base_p90,base_p99,base_p99.9,base_max,status"<<endl;
+	for(auto it=cur.begin();it!=cur.end();it++){
+		cout<<it->first<<","<<it->second.summary()<<",";
+		if(!base.count(it->first)){
+			cout<<",,,,,new"<<endl;
+			continue;
+		}
+		latency_histogram& b = base[it->first];
+		bool bad = latency_regressed(b,it->second,threshold);
+		regressions += bad;
+		cout<<b.summary()<<","<<(bad ? "REGRESSION" : "ok")<<endl;
+	}
+	return regressions!=0;
+}
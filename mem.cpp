@@ -0,0 +1,82 @@
+#include "mem.h"
+
+#include <atomic>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+static const char* names[MEM_COUNT] = {"prk", "vars", "shard_levels", "load_buffers", "coeffs", "upk_cache", "state"};
+
+static atomic<long long> current[MEM_COUNT], peak[MEM_COUNT];
+
+const char* mem_tag_name(int tag){
+	return tag>=0 && tag<MEM_COUNT ? names[tag] : "unknown";
+}
+
+static void raise_peak(int tag, long long value){
+	long long p = peak[tag].load(memory_order_relaxed);
+	while(value>p && !peak[tag].compare_exchange_weak(p, value, memory_order_relaxed));
+}
+
+void mem_add(int tag, long long bytes){
+	raise_peak(tag, current[tag].fetch_add(bytes, memory_order_relaxed)+bytes);
+}
+
+void mem_set(int tag, long long bytes){
+	current[tag].store(bytes, memory_order_relaxed);
+	raise_peak(tag, bytes);
+}
+
+long long mem_current(int tag){
+	return current[tag].load(memory_order_relaxed);
+}
+
+long long mem_peak(int tag){
+	return peak[tag].load(memory_order_relaxed);
+}
+
+void mem_reset_peaks(){
+	for(int i=0;i<MEM_COUNT;i++)
+		peak[i].store(current[i].load(memory_order_relaxed), memory_order_relaxed);
+}
+
+mem_tracker::mem_tracker(int tag, long long bytes){
+	this->tag = tag;
+	this->bytes = 0;
+	set(bytes);
+}
+
+mem_tracker::~mem_tracker(){
+	mem_add(tag, -bytes);
+}
+
+void mem_tracker::set(long long bytes){
+	mem_add(tag, bytes-this->bytes);
+	this->bytes = bytes;
+}
+
+//a "key: value kB" line of /proc/self/status
+static long long status_kb(const char* key){
+	ifstream in("/proc/self/status");
+	string line;
+	size_t n = strlen(key);
+	while(getline(in,line)){
+		if(line.compare(0,n,key)==0)
+			return atoll(line.c_str()+n);
+	}
+	return -1;
+}
+
+long long rss_kb(){
+	return status_kb("VmRSS:");
+}
+
+long long rss_peak_kb(){
+	return status_kb("VmHWM:");
+}
+
+bool rss_reset_peak(){
+	ofstream out("/proc/self/clear_refs");
+	out<<"5"<<endl;
+	return (bool)out;
+}
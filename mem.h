@@ -0,0 +1,51 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <string>
+#include <gmp.h>
+
+using namespace std;
+
+//bytes held by the large structures of vcs, with the peak of each since the last mem_reset_peaks(). only whole
+//buffers are counted (a level of prk, a batch of points), never single elements, so it is always on.
+enum mem_tag{
+	MEM_PRK, //levels 0..lognfiles of prk, held by the caller of keygen/load_key
+	MEM_VARS, //keygen secrets per node of the current and next level
+	MEM_SHARD_LEVELS, //prk levels of the shard being generated
+	MEM_LOAD_BUFFERS, //points read from the shards by get_prk_batch and calc_update_key_batch
+	MEM_COEFFS, //coefficient vectors of setup and prove
+	MEM_UPK_CACHE, //entries of upk_cache
+	MEM_STATE, //value tree nodes of commitment_state, of all versions not yet reclaimed
+	MEM_COUNT
+};
+
+const char* mem_tag_name(int tag);
+void mem_add(int tag, long long bytes);
+//for structures owned by the caller: the tag holds exactly bytes afterwards
+void mem_set(int tag, long long bytes);
+long long mem_current(int tag);
+long long mem_peak(int tag);
+void mem_reset_peaks();
+
+//bytes of a buffer that lives for one scope; set() follows its growth
+class mem_tracker{
+	public:
+	mem_tracker(int tag, long long bytes = 0);
+	~mem_tracker();
+	void set(long long bytes);
+
+	private:
+	int tag;
+	long long bytes;
+};
+
+//an mpz_class of a value below p: the struct and its four limbs
+#define MPZ_BYTES (sizeof(__mpz_struct)+32)
+
+//resident set size of the process in kB, and its peak (VmHWM)
+long long rss_kb();
+long long rss_peak_kb();
+//starts a new peak (Linux >= 4.0, /proc/self/clear_refs); if that fails, rss_peak_kb stays the peak of the whole run
+bool rss_reset_peak();
+
+#endif
@@ -0,0 +1,129 @@
+#include "sparse.h"
+
+#include <fstream>
+#include <vector>
+#include <climits>
+
+//values are field elements, below 2^256
+#define MAX_VALUE_BYTES 32
+
+void sparse_vector::set(long long index, mpz_class value){
+	if(value==0)
+		entries.erase(index);
+	else
+		entries[index] = value;
+}
+
+void sparse_vector::add(long long index, mpz_class delta){
+	auto it = entries.find(index);
+	if(it==entries.end()){
+		set(index,delta);
+		return;
+	}
+	it->second += delta;
+	if(it->second==0)
+		entries.erase(it);
+}
+
+mpz_class sparse_vector::get(long long index) const{
+	auto it = entries.find(index);
+	if(it==entries.end())
+		return 0;
+	return it->second;
+}
+
+size_t sparse_vector::nnz() const{
+	return entries.size();
+}
+
+static void write_varint(ofstream& OutFile, unsigned long long x){
+	while(x>=0x80){
+		OutFile.put((char)((x&0x7f) | 0x80));
+		x>>=7;
+	}
+	OutFile.put((char)x);
+}
+
+static bool read_varint(ifstream& InFile, unsigned long long& x){
+	x = 0;
+	for(int shift=0;shift<64;shift+=7){
+		int c = InFile.get();
+		if(c==EOF)
+			return false;
+		x |= (unsigned long long)(c&0x7f) << shift;
+		if(!(c&0x80))
+			return true;
+	}
+	return false;
+}
+
+bool sparse_vector::save(string filename) const{
+	ofstream OutFile(filename, ios::out | ios::binary);
+	if(!OutFile)
+		return false;
+	
+	write_varint(OutFile, entries.size());
+	
+	long long prev = 0;
+	vector<unsigned char> buf;
+	for(auto it=entries.begin();it!=entries.end();it++){
+		write_varint(OutFile, it->first-prev);
+		prev = it->first;
+		
+		size_t len = (mpz_sizeinbase(it->second.get_mpz_t(),2)+7)/8;
+		buf.resize(len);
+		mpz_export(&buf[0],&len,1,1,1,0,it->second.get_mpz_t());
+		OutFile.put(sgn(it->second)<0 ? 1 : 0);
+		write_varint(OutFile, len);
+		OutFile.write((char*)&buf[0], len);
+	}
+	
+	return (bool)OutFile;
+}
+
+bool sparse_vector::load(string filename){
+	ifstream InFile(filename, ios::in | ios::binary);
+	if(!InFile)
+		return false;
+	
+	entries.clear();
+	
+	InFile.seekg(0, ios::end);
+	long long size = InFile.tellg();
+	InFile.seekg(0, ios::beg);
+	
+	unsigned long long count, delta, len;
+	if(!read_varint(InFile, count))
+		return false;
+	
+	long long index = 0;
+	vector<unsigned char> buf(MAX_VALUE_BYTES);
+	for(unsigned long long i=0;i<count;i++){
+		//indices strictly increase from the first one, which may be 0
+		if(!read_varint(InFile, delta) || (i>0 && delta==0) || delta>(unsigned long long)(LLONG_MAX-index)){
+			entries.clear();
+			return false;
+		}
+		index += delta;
+		
+		int negative = InFile.get();
+		if((negative!=0 && negative!=1) || !read_varint(InFile, len) || len==0 || len>MAX_VALUE_BYTES
+			|| (long long)len>size-(long long)InFile.tellg()){
+			entries.clear();
+			return false;
+		}
+		InFile.read((char*)&buf[0], len);
+		
+		mpz_class value;
+		mpz_import(value.get_mpz_t(),len,1,1,1,0,&buf[0]);
+		if(!InFile || value==0){
+			entries.clear();
+			return false;
+		}
+		if(negative)
+			value = -value;
+		entries.insert(entries.end(), make_pair(index,value));
+	}
+	
+	return true;
+}
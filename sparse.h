@@ -0,0 +1,29 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <map>
+#include <string>
+#include <gmp.h>
+#include <gmpxx.h>
+
+using namespace std;
+
+//the committed vector as index->value for its non-zero entries only. commit and prove on it cost
+//time proportional to the number of non-zero entries instead of N.
+class sparse_vector{
+	public:
+	map<long long, mpz_class> entries; //sorted by index, never holds a zero
+	
+	void set(long long index, mpz_class value);
+	void add(long long index, mpz_class delta);
+	mpz_class get(long long index) const;
+	size_t nnz() const;
+	
+	//on disk: entry count, then per entry the index delta to the previous entry as a varint and the value as sign, byte length and magnitude.
+	//load fails and leaves the vector empty on a truncated file, a zero value, a value over 32 bytes, or indices
+	//that do not strictly increase
+	bool save(string filename) const;
+	bool load(string filename);
+};
+
+#endif
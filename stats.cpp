@@ -0,0 +1,111 @@
+#include "stats.h"
+
+#include <vector>
+#include <mutex>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <gmp.h>
+
+static const char* names[STAT_COUNT] = {
+	"pairings", "mul_64", "mul_128", "mul_256", "point_adds", "point_dbls",
+	"gmp_allocs", "files_opened", "bytes_read"
+};
+
+const char* stat_name(int counter){
+	return counter>=0 && counter<STAT_COUNT ? names[counter] : "unknown";
+}
+
+vcs_stats::vcs_stats(){
+	for(int i=0;i<STAT_COUNT;i++)
+		c[i] = 0;
+}
+
+vcs_stats vcs_stats::operator-(const vcs_stats& b) const{
+	vcs_stats d;
+	for(int i=0;i<STAT_COUNT;i++)
+		d.c[i] = c[i]-b.c[i];
+	return d;
+}
+
+string vcs_stats::csv_header(){
+	string out;
+	for(int i=0;i<STAT_COUNT;i++)
+		out += string(i ? "," : "")+names[i];
+	return out;
+}
+
+string vcs_stats::csv() const{
+	stringstream out;
+	for(int i=0;i<STAT_COUNT;i++)
+		out<<(i ? "," : "")<<c[i];
+	return out.str();
+}
+
+
+struct stat_registry{
+	mutex m;
+	vector<stat_block*> live;
+	vcs_stats retired; //counts of threads that exited
+};
+
+static stat_registry& registry(){
+	static stat_registry* r = new stat_registry; //never destroyed, threads may exit during static destruction
+	return *r;
+}
+
+struct stat_owner{
+	stat_block block;
+
+	stat_owner(){
+		for(int i=0;i<STAT_COUNT;i++)
+			block.c[i].store(0, memory_order_relaxed);
+		stat_registry& r = registry();
+		lock_guard<mutex> lock(r.m);
+		r.live.push_back(&block);
+	}
+	~stat_owner(){
+		stat_registry& r = registry();
+		lock_guard<mutex> lock(r.m);
+		for(int i=0;i<STAT_COUNT;i++)
+			r.retired.c[i] += block.c[i].load(memory_order_relaxed);
+		r.live.erase(find(r.live.begin(),r.live.end(),&block));
+	}
+};
+
+stat_block& thread_stats(){
+	static thread_local stat_owner owner;
+	return owner.block;
+}
+
+vcs_stats vcs_stats_snapshot(){
+	stat_registry& r = registry();
+	lock_guard<mutex> lock(r.m);
+	vcs_stats s = r.retired;
+	for(size_t k=0;k<r.live.size();k++){
+		for(int i=0;i<STAT_COUNT;i++)
+			s.c[i] += r.live[k]->c[i].load(memory_order_relaxed);
+	}
+	return s;
+}
+
+
+#ifdef VCS_STATS
+//GMP allocates through these once installed; they forward to the C allocator GMP uses by default, so blocks
+//allocated before installation are still freed correctly
+static void* gmp_alloc(size_t n){
+	stat_add(STAT_GMP_ALLOCS, 1);
+	return malloc(n);
+}
+
+static void* gmp_realloc(void* p, size_t /*old_n*/, size_t n){
+	stat_add(STAT_GMP_ALLOCS, 1);
+	return realloc(p, n);
+}
+
+static void gmp_free(void* p, size_t /*n*/){
+	free(p);
+}
+
+static int gmp_hooks = (mp_set_memory_functions(gmp_alloc, gmp_realloc, gmp_free), 0);
+#endif
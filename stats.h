@@ -0,0 +1,58 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <atomic>
+
+using namespace std;
+
+//operation counters, compiled in with -DVCS_STATS. every thread bumps its own block without locking, a snapshot
+//sums the blocks of all live threads and of the threads that already exited. the difference of two snapshots
+//around a call tells how much of it was group arithmetic and how much was I/O.
+enum stat_counter{
+	STAT_PAIRINGS, //opt_atePairing calls, each a Miller loop and a final exponentiation
+	STAT_MUL_64, //G1 scalar multiplications by scalars of up to 64 bits
+	STAT_MUL_128, //up to 128 bits, plain wNAF
+	STAT_MUL_256, //full size, GLV split
+	STAT_POINT_ADDS, //G1 additions inside ec1_mul and ec1_add_batch, and single ones through ec1_add/ec1_sub
+	STAT_POINT_DBLS,
+	STAT_GMP_ALLOCS, //allocations and reallocations through GMP's memory functions
+	STAT_FILES_OPENED, //key files opened for reading
+	STAT_BYTES_READ, //bytes read from key files
+	STAT_COUNT
+};
+
+struct vcs_stats{
+	long long c[STAT_COUNT];
+
+	vcs_stats();
+	vcs_stats operator-(const vcs_stats& b) const;
+
+	//"pairings,mul_64,...", and the values in the same order
+	static string csv_header();
+	string csv() const;
+};
+
+const char* stat_name(int counter);
+vcs_stats vcs_stats_snapshot();
+
+struct stat_block{
+	atomic<long long> c[STAT_COUNT];
+};
+
+//the block of the calling thread, registered on first use
+stat_block& thread_stats();
+
+//only the owning thread writes its block, so a relaxed load and store is enough
+inline void stat_add(int counter, long long n){
+	atomic<long long>& c = thread_stats().c[counter];
+	c.store(c.load(memory_order_relaxed)+n, memory_order_relaxed);
+}
+
+#ifdef VCS_STATS
+#define STAT_ADD(counter, n) stat_add(counter, n)
+#else
+#define STAT_ADD(counter, n) do{}while(0)
+#endif
+
+#endif
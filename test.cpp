@@ -1,4 +1,11 @@
 #include "vcs.h"
+#include "ec1_batch.h"
+#include "wire.h"
+#include "latency.h"
+#include "stats.h"
+#include "trace.h"
+#include "mem.h"
+#include "commitment_state.h"
 
 #include "benchmark.h"
 
@@ -7,7 +14,10 @@
 #include <thread>
 #include <vector>
 #include <sstream>
+#include <fstream>
 #include <map>
+#include <set>
+#include <atomic>
 
 #include "test_point.hpp"
 #include "bn.h"
@@ -18,6 +28,251 @@
 using namespace std;
 using namespace bn;
 
+//p50,p90,p99,p99.9,max of the iterations after warm-up, on stderr so the raw rows on stdout stay as they were
+void print_summary(const char* name, vector<chrono::duration<double, micro>>& m, int warm){
+	latency_histogram h;
+	for(size_t j=warm;j<m.size();j++)
+		h.record((long long)m[j].count());
+	cerr<<name<<","<<h.summary()<<endl;
+}
+
+//operation counters of the timed calls of a block, "stats,name,calls,<counters>" on stderr with -DVCS_STATS
+struct block_stats{
+	vcs_stats sum, start;
+	int calls = 0;
+
+	void begin(){
+#ifdef VCS_STATS
+		start = vcs_stats_snapshot();
+#endif
+	}
+	void end(){
+#ifdef VCS_STATS
+		vcs_stats d = vcs_stats_snapshot()-start;
+		for(int i=0;i<STAT_COUNT;i++)
+			sum.c[i] += d.c[i];
+		calls++;
+#endif
+	}
+	void print(const char* name){
+#ifdef VCS_STATS
+		cerr<<"stats,"<<name<<","<<calls<<","<<sum.csv()<<endl;
+#endif
+	}
+};
+
+//peak RSS and peak tracked bytes per structure since the previous call, "mem,phase,peak_rss_kb,<bytes per tag>" on stderr
+void mem_phase(const char* phase){
+	cerr<<"mem,"<<phase<<","<<rss_peak_kb();
+	for(int i=0;i<MEM_COUNT;i++)
+		cerr<<","<<mem_peak(i);
+	cerr<<endl;
+	rss_reset_peak();
+	mem_reset_peaks();
+}
+
+//./test [number] large: checks vectors beyond 2^31 elements without a dense vals array. the all-zero vector has the identity
+//as digest and as every proof, so the test starts there, applies random updates with update keys read from disk and verifies tracked proofs.
+int large_test(vcs& a, vector<vector<Ec1> >& prk, vector<Ec2>& vrk, mt19937_64& gen){
+	uniform_int_distribution<long long> idistrib(0, a.N-1);
+	uniform_int_distribution<long long> vdistrib(-(1LL<<40), 1LL<<40);
+	int tracked = 16, updates = 256;
+	
+	vector<long long> index(tracked);
+	for (int t = 0; t < tracked; t++) {
+	  index[t] = idistrib(gen);
+	}
+	index[0] = a.N-1;
+	if (a.L > 31) {
+	  index[1] = (1LL << 31) | idistrib(gen) >> 33;
+	}
+	
+	Ec1 digest = a.g1*0;
+	map<long long, mpz_class> vals;
+	vector<vector<Ec1> > proofs(tracked, vector<Ec1>(a.L, a.g1*0));
+	
+	vector<long long> update_indexes(updates);
+	for (int j = 0; j < updates; j++) {
+	  update_indexes[j] = j%2 ? index[j/2%tracked] : idistrib(gen);
+	}
+	auto upk = a.calc_update_key_batch(update_indexes, prk);
+	
+	for (int j = 0; j < updates; j++) {
+	  long long u = update_indexes[j];
+	  mpz_class delta;
+	  mpz_set_si(delta.get_mpz_t(), vdistrib(gen));
+	  digest = a.update_digest(digest, u, delta, upk[j]);
+	  vals[u] += delta;
+	  for (int t = 0; t < tracked; t++) {
+	    proofs[t] = a.update_proof(proofs[t], u, index[t], delta, upk[j]);
+	  }
+	}
+	
+	int errs = 0;
+	for (int t = 0; t < tracked; t++) {
+	  if (!a.verify(digest, index[t], vals[index[t]], proofs[t], vrk)) {
+	    errs += 1;
+	  }
+	}
+	cout << "large," << a.N << "," << errs << endl;
+	return errs;
+}
+
+struct state_readers{
+	commitment_state* state;
+	vcs* a;
+	vector<Ec2>* vrk;
+	vector<long long>* tracked;
+	atomic<bool> done;
+	atomic<long long> reads, bad;
+};
+
+//verifies the proof of a tracked index against the digest of the same snapshot until done
+void state_reader(state_readers* r, int t){
+	mt19937 gen(t);
+	vector<Ec1> proof;
+	while (!r->done.load()) {
+	  commitment_state::snapshot snap = r->state->read();
+	  long long i = (*r->tracked)[gen() % r->tracked->size()];
+	  if (!snap.proof(i, proof) || !r->a->verify(snap.digest(), i, snap.value(i), proof, *r->vrk)) {
+	    r->bad++;
+	  }
+	  r->reads++;
+	}
+}
+
+//sparse_vector save/load: a round trip of vals with every 4th entry zeroed and a few negated, then files that
+//load must reject: truncated, a zero value, a repeated index and a value over 32 bytes. prints sparse,nnz,errs
+int sparse_test(vector<mpz_class>& vals){
+	sparse_vector sv, back;
+	for (size_t i = 0; i < vals.size(); i++) {
+	  sv.set(i, i%4 == 0 ? mpz_class(0) : i%3 == 0 ? mpz_class(-vals[i]) : vals[i]);
+	}
+	int errs = 0;
+	if (!sv.save("sparse.bin") || !back.load("sparse.bin") || back.entries != sv.entries) {
+	  errs++;
+	}
+
+	string saved;
+	{
+	  ifstream in("sparse.bin", ios::binary);
+	  saved.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	}
+	string bad[] = {
+	  saved.substr(0, saved.size() - 1),
+	  string("\x01\x05\x00\x01\x00", 5),
+	  string("\x02\x05\x00\x01\x07\x00\x00\x01\x07", 9),
+	  string("\x01\x05\x00\x21", 4) + string(33, '\x07'),
+	};
+	for (auto& b : bad) {
+	  ofstream("sparse.bin", ios::binary) << b;
+	  if (back.load("sparse.bin") || back.nnz() != 0) {
+	    errs++;
+	  }
+	}
+	remove("sparse.bin");
+
+	cout << "sparse," << sv.nnz() << "," << errs << endl;
+	return errs;
+}
+
+//commitment_state under load: readers check snapshots while blocks of 16 updates are queued, then a checkpoint,
+//16 updates only the log holds and a restart from both. prints state,updates,us_per_update,reads,bad and
+//checkpoint,bytes,save_us,recover_us,bad
+int state_test(vcs& a, vector<vector<Ec1> >& prk, vector<Ec2>& vrk, vector<mpz_class>& vals, vector<long long> tracked, mt19937& gen){
+	uniform_int_distribution<long long> idistrib(0, a.N-1);
+	int updates = 256;
+
+	sparse_vector sv;
+	for (long long i = 0; i < a.N; i++) {
+	  sv.set(i, vals[i]);
+	}
+	commitment_state* state = new commitment_state(a, prk, vrk, sv, "state.wal");
+	for (auto i : tracked) {
+	  state->track(i);
+	}
+	state->flush();
+
+	state_readers r;
+	r.state = state;
+	r.a = &a;
+	r.vrk = &vrk;
+	r.tracked = &tracked;
+	r.done = false;
+	r.reads = r.bad = 0;
+	int nreaders = max(1, (int)thread::hardware_concurrency() - 1);
+	vector<thread> readers;
+	for (int t = 0; t < nreaders; t++) {
+	  readers.push_back(thread(state_reader, &r, t));
+	}
+
+	auto t1 = chrono::steady_clock::now();
+	vector<pair<long long, mpz_class> > block;
+	for (int j = 0; j < updates; j++) {
+	  long long u = j%4 ? idistrib(gen) : tracked[j/4 % tracked.size()];
+	  block.push_back(make_pair(u, mpz_class((unsigned int)gen())));
+	  if (block.size() == 16) {
+	    state->update(block);
+	    block.clear();
+	  }
+	}
+	state->flush();
+	auto t2 = chrono::steady_clock::now();
+	r.done = true;
+	for (auto& th : readers) {
+	  th.join();
+	}
+
+	if (state->read().seq() != updates) {
+	  r.bad++;
+	}
+	cout << "state," << updates << "," << int(chrono::duration<double, micro>(t2 - t1).count() / updates) << "," << r.reads << "," << r.bad << endl;
+
+	int ckpt_bad = 0;
+	t1 = chrono::steady_clock::now();
+	if (!state->checkpoint("state.ckpt")) {
+	  ckpt_bad++;
+	}
+	t2 = chrono::steady_clock::now();
+	double save_us = chrono::duration<double, micro>(t2 - t1).count();
+	for (int j = 0; j < 16; j++) {
+	  state->update(idistrib(gen), mpz_class((unsigned int)gen()));
+	}
+	state->flush();
+
+	Ec1 digest;
+	long long seq;
+	vector<vector<Ec1> > proofs(tracked.size());
+	{
+	  commitment_state::snapshot snap = state->read();
+	  digest = snap.digest();
+	  seq = snap.seq();
+	  for (size_t k = 0; k < tracked.size(); k++) {
+	    snap.proof(tracked[k], proofs[k]);
+	  }
+	}
+	delete state;
+
+	t1 = chrono::steady_clock::now();
+	commitment_state recovered(a, prk, vrk, "state.ckpt", "state.wal");
+	t2 = chrono::steady_clock::now();
+	double recover_us = chrono::duration<double, micro>(t2 - t1).count();
+
+	commitment_state::snapshot snap = recovered.read();
+	if (!recovered.ok() || snap.seq() != seq || !(snap.digest() == digest)) {
+	  ckpt_bad++;
+	}
+	for (size_t k = 0; k < tracked.size(); k++) {
+	  vector<Ec1> proof;
+	  if (!snap.proof(tracked[k], proof) || proof != proofs[k] || !a.verify(digest, tracked[k], snap.value(tracked[k]), proof, vrk)) {
+	    ckpt_bad++;
+	  }
+	}
+	ifstream ckpt("state.ckpt", ios::binary | ios::ate);
+	cout << "checkpoint," << ckpt.tellg() << "," << int(save_us) << "," << int(recover_us) << "," << ckpt_bad << endl;
+	return r.bad + ckpt_bad;
+}
+
 int main(int argc, char** argv){
 	// init
 	int L = atoi(argv[1]);
@@ -54,14 +309,41 @@ int main(int argc, char** argv){
 	gmp_randseed_ui(r_state, seed);
 	
 	vcs a(L,p,g1,g2);
+#ifdef VCS_TRACE
+	trace_start();
+#endif
+	
+	//./test [number] [layout] [block_height], layout 0 stores shards level by level, 1 in blocks of block_height levels
+	bool large = argc>2 && string(argv[2])=="large";
+	if(argc>2 && !large && !a.set_layout(3, "", atoi(argv[2]), argc>3 ? atoi(argv[3]) : 4))
+		return 1;
 	
 	auto t2 = chrono::steady_clock::now();
 	
 	vector<vector<Ec1> > prk;
 	vector<Ec2> vrk;
 
-	a.keygen(prk, vrk);
-	a.load_key(prk,vrk);
+	cerr << "mem,phase,peak_rss_kb";
+	for (int i = 0; i < MEM_COUNT; i++)
+	  cerr << "," << mem_tag_name(i);
+	cerr << endl;
+	rss_reset_peak();
+	if (!a.keygen(prk, vrk)) {
+	  cerr << "keygen failed" << endl;
+	  return 1;
+	}
+	mem_phase("keygen");
+	if (!a.load_key(prk, vrk)) {
+	  cerr << "load_key failed" << endl;
+	  return 1;
+	}
+	mem_phase("load_key");
+	
+	if (large) {
+	  mt19937_64 gen64(distrib(gen));
+	  return large_test(a, prk, vrk, gen64) != 0;
+	}
+	uniform_int_distribution<long long> idistrib(0, a.N-1);
 	
 	auto t3 = chrono::steady_clock::now();
 	// auto t4 = t3 - t2;
@@ -73,6 +355,9 @@ int main(int argc, char** argv){
 	
 	// start
 	int errs = 0;
+#ifdef VCS_STATS
+	cerr << "stats,op,calls," << vcs_stats::csv_header() << endl;
+#endif
 	// cout << "B," << a.N << endl;
 	auto iters = 1000;
 	auto warm = 100;
@@ -87,13 +372,13 @@ int main(int argc, char** argv){
 	t1 = chrono::duration<double, micro>::zero();
 	// for (int k = 0; k < tot_iters; k++) {
 	for (int k = 0; k < 1; k++) { // cut to save time (not measuring commit)
-	  for (int i = 0; i < a.N; i++) {
+	  for (long long i = 0; i < a.N; i++) {
 	    vals[i] = distrib(gen);
 	  }
 
 	  t2 = chrono::steady_clock::now();
 	  {
-	    for (int i = 0; i < a.N; i++) {
+	    for (long long i = 0; i < a.N; i++) {
 	      auto upk_i = a.calc_update_key(i, prk);
 	      benchmark::DoNotOptimize(digest = a.update_digest(digest, i, vals[i], upk_i));
 	      benchmark::ClobberMemory();
@@ -118,11 +403,13 @@ int main(int argc, char** argv){
 	}
 	// cout << "commit," << int(t1.count()/iters) << "," << int(tmin.count()) << "," << int(tmax.count()) << endl;
 
+	mem_phase("commit");
+
 	// open
-	vector<int> open_indexes(tot_iters);
+	vector<long long> open_indexes(tot_iters);
 	vector<vector<Ec1> > proofs(tot_iters);
 	for (int j = 0; j < tot_iters; j++) {
-	  open_indexes[j] = distrib(gen) % a.N;
+	  open_indexes[j] = idistrib(gen);
 	}
 
 	{
@@ -151,12 +438,16 @@ int main(int argc, char** argv){
 	  // cout << "open," << int(t1.count()/iters) << "," << int(tmin.count()) << "," << int(tmax.count()) << endl;
 	}
 
+	mem_phase("open");
+
 	// verify
 	{
 	  vector<chrono::duration<double, micro>> verify_m(tot_iters);
+	  block_stats verify_st;
 	  for (int j = 0; j < tot_iters; j++) {
 	    auto i = open_indexes[j];
 
+	    verify_st.begin();
 	    t2 = chrono::steady_clock::now();
 	    bool ok;
 	    benchmark::DoNotOptimize(ok = a.verify(digest, i, vals[i], proofs[j], vrk));
@@ -165,6 +456,7 @@ int main(int argc, char** argv){
 	    }
 	    benchmark::ClobberMemory();
 	    t3 = chrono::steady_clock::now();
+	    verify_st.end();
 	    t4 = chrono::duration<double, micro>(t3 - t2);
 	    verify_m[j] = t4;
 	  }
@@ -173,6 +465,8 @@ int main(int argc, char** argv){
 	    cout << int(verify_m[j].count()) << ",";
 	  }
 	  cout << endl;
+	  print_summary("verify", verify_m, warm);
+	  verify_st.print("verify");
 	  t1 = verify_m[warm];
 	  tmin = t1;
 	  tmax = t1;
@@ -188,25 +482,85 @@ int main(int argc, char** argv){
 	  // cout << "verify," << int(t1.count()/iters) << "," << int(tmin.count()) << "," << int(tmax.count()) << endl;
 	}
 	
+	mem_phase("verify");
+
+	// compressed wire format: the opened proofs encoded in one buffer, decoded in one batch and checked with batch_verify
+	{
+	  t2 = chrono::steady_clock::now();
+	  string wire = encode_proofs(proofs);
+	  t3 = chrono::steady_clock::now();
+	  double encode_us = chrono::duration<double, micro>(t3 - t2).count();
+
+	  vector<vector<Ec1> > decoded;
+	  t2 = chrono::steady_clock::now();
+	  bool ok = decode_proofs(wire, L, decoded);
+	  t3 = chrono::steady_clock::now();
+	  double decode_us = chrono::duration<double, micro>(t3 - t2).count();
+
+	  vector<mpz_class> open_vals;
+	  for (auto i : open_indexes)
+	    open_vals.push_back(vals[i]);
+	  if (!ok || !a.batch_verify(digest, open_indexes, open_vals, decoded, vrk)) {
+	    errs += 1;
+	  }
+	  cout << "wire," << proofs.size() << "," << proofs.size()*L*sizeof(Ec1) << "," << wire.size() << "," << int(encode_us) << "," << int(decode_us) << endl;
+	}
+
+	// multi-index opening: witnesses sent, total time of prove_multi + verify_multi against k proofs and verifies
+	for (int k : {4, 16}) {
+	  vector<long long> multi_indexes(open_indexes.begin(), open_indexes.begin() + min(k, (int)open_indexes.size()));
+	  vector<mpz_class> multi_vals;
+
+	  t2 = chrono::steady_clock::now();
+	  multi_proof mp = a.prove_multi(multi_indexes, vals, prk);
+	  t3 = chrono::steady_clock::now();
+	  double prove_us = chrono::duration<double, micro>(t3 - t2).count();
+	  for (auto i : mp.index)
+	    multi_vals.push_back(vals[i]);
+
+	  t2 = chrono::steady_clock::now();
+	  if (!a.verify_multi(digest, mp, multi_vals, vrk)) {
+	    errs += 1;
+	  }
+	  t3 = chrono::steady_clock::now();
+	  double verify_us = chrono::duration<double, micro>(t3 - t2).count();
+
+	  double separate_us = 0;
+	  for (auto i : mp.index) {
+	    t2 = chrono::steady_clock::now();
+	    auto proof = a.prove(i, vals, prk);
+	    benchmark::DoNotOptimize(a.verify(digest, i, vals[i], proof, vrk));
+	    t3 = chrono::steady_clock::now();
+	    separate_us += chrono::duration<double, micro>(t3 - t2).count();
+	  }
+	  cout << "multi_open," << mp.index.size() << "," << mp.witness.size() << "," << mp.index.size()*L << "," << int(prove_us + verify_us) << "," << int(separate_us) << endl;
+	}
+
+	mem_phase("wire_multi_open");
+
 	// update commit
+	Ec1 vals_digest = digest; // commit_update moves digest away from vals
 	vector<long long int> update_indexes(tot_iters);
 	vector<int> update_vals(tot_iters);
 	for (int j = 0; j < tot_iters; j++) {
-	  update_indexes[j] = distrib(gen) % a.N;
+	  update_indexes[j] = idistrib(gen);
 	  update_vals[j] = distrib(gen);
 	}
 	auto upk_is = a.calc_update_key_batch(update_indexes, prk);
 
 	{
 	  vector<chrono::duration<double, micro>> cupdate_m(tot_iters);
+	  block_stats cupdate_st;
 	  for (int j = 0; j < tot_iters; j++) {
 	    auto i = update_indexes[j];
 	    auto upk_i = upk_is[j];
 
+	    cupdate_st.begin();
 	    t2 = chrono::steady_clock::now();
 	    benchmark::DoNotOptimize(digest = a.update_digest(digest, i, update_vals[j], upk_i));
 	    benchmark::ClobberMemory();
 	    t3 = chrono::steady_clock::now();
+	    cupdate_st.end();
 	    t4 = chrono::duration<double, micro>(t3 - t2);;
 	    cupdate_m[j] = t4;
 	  }
@@ -215,6 +569,8 @@ int main(int argc, char** argv){
 	    cout << int(cupdate_m[j].count()) << ",";
 	  }
 	  cout << endl;
+	  print_summary("commit_update", cupdate_m, warm);
+	  cupdate_st.print("commit_update");
 	  t1 = cupdate_m[warm];
 	  tmin = t1;
 	  tmax = t1;
@@ -230,20 +586,25 @@ int main(int argc, char** argv){
 	  // cout << "commit_update," << int(t1.count()/iters) << "," << int(tmin.count()) << "," << int(tmax.count()) << endl;
 	}
 	
+	mem_phase("commit_update");
+
 	// update proof
 	{
 	  vector<chrono::duration<double, micro>> pupdate_m(tot_iters);
+	  block_stats pupdate_st;
 	  for (int j = 0; j < tot_iters; j++) {
 	    auto i = update_indexes[j];
 	    auto upk_i = upk_is[j];
 
-	    auto l = distrib(gen) % a.N;
+	    auto l = idistrib(gen);
 	    auto proofl = a.prove(l, vals, prk);
 
+	    pupdate_st.begin();
 	    t2 = chrono::steady_clock::now();
 	    benchmark::DoNotOptimize(proofl = a.update_proof(proofl, i, l, update_vals[j], upk_i));
 	    benchmark::ClobberMemory();
 	    t3 = chrono::steady_clock::now();
+	    pupdate_st.end();
 	    t4 = chrono::duration<double, micro>(t3 - t2);;
 	    pupdate_m[j] = t4;
 	  }
@@ -252,6 +613,8 @@ int main(int argc, char** argv){
 	    cout << int(pupdate_m[j].count()) << ",";
 	  }
 	  cout << endl;
+	  print_summary("proof_update", pupdate_m, warm);
+	  pupdate_st.print("proof_update");
 	  t1 = pupdate_m[warm];
 	  tmin = t1;
 	  tmax = t1;
@@ -267,6 +630,102 @@ int main(int argc, char** argv){
 	  // cout << "proof_update," << int(t1.count()/iters) << "," << int(tmin.count()) << "," << int(tmax.count()) << endl;
 	}
 
+	mem_phase("proof_update");
+
+	// same updates through the 64-bit delta path with precomputed update key tables, checked against the mpz path
+	{
+	  vector<chrono::duration<double, micro>> table_m(tot_iters), cupdate_m(tot_iters), pupdate_m(tot_iters);
+	  int si_errs = 0;
+	  for (int j = 0; j < tot_iters; j++) {
+	    auto i = update_indexes[j];
+	    long long delta = update_vals[j];
+
+	    t2 = chrono::steady_clock::now();
+	    auto upk_t = a.upk_tables(upk_is[j]);
+	    t3 = chrono::steady_clock::now();
+	    table_m[j] = chrono::duration<double, micro>(t3 - t2);
+
+	    Ec1 digest_si = digest;
+	    t2 = chrono::steady_clock::now();
+	    benchmark::DoNotOptimize(digest_si = a.update_digest(digest_si, i, delta, upk_t));
+	    benchmark::ClobberMemory();
+	    t3 = chrono::steady_clock::now();
+	    cupdate_m[j] = chrono::duration<double, micro>(t3 - t2);
+	    if (!(digest_si == a.update_digest(digest, i, update_vals[j], upk_is[j])))
+	      si_errs += 1;
+
+	    auto l = idistrib(gen);
+	    auto proofl = a.prove(l, vals, prk);
+	    auto proof_si = proofl;
+
+	    t2 = chrono::steady_clock::now();
+	    benchmark::DoNotOptimize(proof_si = a.update_proof(proof_si, i, l, delta, upk_t));
+	    benchmark::ClobberMemory();
+	    t3 = chrono::steady_clock::now();
+	    pupdate_m[j] = chrono::duration<double, micro>(t3 - t2);
+	    if (proof_si != a.update_proof(proofl, i, l, update_vals[j], upk_is[j]))
+	      si_errs += 1;
+
+	    // the updated proof opens vals with the delta applied against vals_digest with it applied
+	    if (j == warm) {
+	      mpz_class val_l = vals[l];
+	      if (l == i)
+	        val_l += update_vals[j];
+	      if (!a.verify(a.update_digest(vals_digest, i, delta, upk_t), l, val_l, proof_si, vrk))
+	        si_errs += 1;
+	    }
+	  }
+	  cout << "update_si_errs," << si_errs << endl;
+	  errs += si_errs;
+	  cout << "upk_tables,";
+	  for (int j = warm; j < tot_iters; j++) {
+	    cout << int(table_m[j].count()) << ",";
+	  }
+	  cout << endl;
+	  print_summary("upk_tables", table_m, warm);
+	  cout << "commit_update_si,";
+	  for (int j = warm; j < tot_iters; j++) {
+	    cout << int(cupdate_m[j].count()) << ",";
+	  }
+	  cout << endl;
+	  print_summary("commit_update_si", cupdate_m, warm);
+	  cout << "proof_update_si,";
+	  for (int j = warm; j < tot_iters; j++) {
+	    cout << int(pupdate_m[j].count()) << ",";
+	  }
+	  cout << endl;
+	  print_summary("proof_update_si", pupdate_m, warm);
+	}
+
+	// independent additions one by one and through ec1_add_batch, ns per addition
+	{
+	  vector<Ec1> xs, ys, r1, r2;
+	  for (int j = 0; j < tot_iters; j++) {
+	    for (int k = 0; k + 1 < L; k += 2) {
+	      xs.push_back(upk_is[j][k]);
+	      ys.push_back(upk_is[j][k+1]);
+	    }
+	  }
+	  r1.resize(xs.size());
+	  r2.resize(xs.size());
+
+	  t2 = chrono::steady_clock::now();
+	  for (size_t k = 0; k < xs.size(); k++)
+	    r1[k] = xs[k] + ys[k];
+	  benchmark::ClobberMemory();
+	  t3 = chrono::steady_clock::now();
+	  double scalar_ns = chrono::duration<double, nano>(t3 - t2).count() / xs.size();
+
+	  t2 = chrono::steady_clock::now();
+	  ec1_add_batch(r2.data(), xs.data(), ys.data(), xs.size());
+	  benchmark::ClobberMemory();
+	  t3 = chrono::steady_clock::now();
+	  double batch_ns = chrono::duration<double, nano>(t3 - t2).count() / xs.size();
+
+	  errs += r1 != r2;
+	  cout << "batch_add," << ec1_batch_backend() << "," << scalar_ns << "," << batch_ns << endl;
+	}
+
 	// 100 micros sanity check
 	{
 	  vector<chrono::duration<double, micro>> sanity_m(tot_iters);
@@ -274,7 +733,7 @@ int main(int argc, char** argv){
 	    auto i = update_indexes[j];
 	    auto upk_i = upk_is[j];
 
-	    auto l = distrib(gen) % a.N;
+	    auto l = idistrib(gen);
 	    auto proofl = a.prove(l, vals, prk);
 
 	    t2 = chrono::steady_clock::now();
@@ -289,6 +748,7 @@ int main(int argc, char** argv){
 	    cout << int(sanity_m[j].count()) << ",";
 	  }
 	  cout << endl;
+	  print_summary("100micros", sanity_m, warm);
 	  t1 = sanity_m[warm];
 	  tmin = t1;
 	  tmax = t1;
@@ -304,6 +764,100 @@ int main(int argc, char** argv){
 	  // cout << "100micros," << int(t1.count()/iters) << "," << int(tmin.count()) << "," << int(tmax.count()) << endl;
 	}
 	
+	// cold-cache update key fetch of random indices
+	{
+	  vector<chrono::duration<double, micro>> cold_m(tot_iters);
+	  block_stats cold_st;
+	  vector<int> pages_m(tot_iters);
+	  for (int j = 0; j < tot_iters; j++) {
+	    long long i = idistrib(gen);
+
+	    set<long long> pages;
+	    for (int k = a.lognfiles + 1; k < a.L + 1; k++) {
+	      long long keynum = (i >> (a.L - k)) & ((1LL << (k - a.lognfiles)) - 1);
+	      pages.insert(a.shard_offset(k, keynum) / PAGE_BYTES);
+	      pages.insert((a.shard_offset(k, keynum) + sizeof(Ec1) - 1) / PAGE_BYTES);
+	    }
+	    pages_m[j] = pages.size();
+
+	    a.evict_keys();
+	    cold_st.begin();
+	    t2 = chrono::steady_clock::now();
+	    benchmark::DoNotOptimize(a.calc_update_key(i, prk));
+	    benchmark::ClobberMemory();
+	    t3 = chrono::steady_clock::now();
+	    cold_st.end();
+	    t4 = chrono::duration<double, micro>(t3 - t2);
+	    cold_m[j] = t4;
+	  }
+	  cout << "upk_cold,";
+	  for (int j = warm; j < tot_iters; j++) {
+	    cout << int(cold_m[j].count()) << ",";
+	  }
+	  cout << endl;
+	  print_summary("upk_cold", cold_m, warm);
+	  cold_st.print("upk_cold");
+	  cout << "upk_pages,";
+	  for (int j = warm; j < tot_iters; j++) {
+	    cout << pages_m[j] << ",";
+	  }
+	  cout << endl;
+	}
+	
+	// cold-cache update key fetch of 64 hot indices through the upk_cache, checked against the keys read from the shards
+	{
+	  a.enable_cache(1 << 12, 1024, 4); // room to spare, the segments do not fill evenly
+	  vector<long long> hot(update_indexes.begin(), update_indexes.begin() + 64);
+	  int cache_errs = 0;
+	  // the first round fills the caches, the second is served from them
+	  for (int round = 0; round < 2; round++) {
+	    auto upk_hot = a.calc_update_key_batch(hot, prk);
+	    for (int k = 0; k < 64; k++)
+	      cache_errs += upk_hot[k] != upk_is[k];
+	  }
+
+	  vector<chrono::duration<double, micro>> cached_m(tot_iters);
+	  for (int j = 0; j < tot_iters; j++) {
+	    a.evict_keys();
+	    vector<Ec1> upk;
+	    t2 = chrono::steady_clock::now();
+	    benchmark::DoNotOptimize(upk = a.calc_update_key(hot[j % 64], prk));
+	    benchmark::ClobberMemory();
+	    t3 = chrono::steady_clock::now();
+	    cached_m[j] = chrono::duration<double, micro>(t3 - t2);
+	    cache_errs += upk != upk_is[j % 64];
+	  }
+	  cout << "upk_cached,";
+	  for (int j = warm; j < tot_iters; j++) {
+	    cout << int(cached_m[j].count()) << ",";
+	  }
+	  cout << endl;
+	  print_summary("upk_cached", cached_m, warm);
+	  cout << "upk_cache_errs," << cache_errs << "," << a.cache->upk_hits << "," << a.cache->upk_misses << endl;
+	  errs += cache_errs;
+	  a.disable_cache();
+	}
+
+	errs += sparse_test(vals);
+
+	// concurrent reads of the commitment_state engine while it applies updates
+	errs += state_test(a, prk, vrk, vals, vector<long long>(open_indexes.begin(), open_indexes.begin() + 8), gen);
+	mem_phase("state");
+
+#ifdef VCS_TRACE
+	// the last TRACE_CAPACITY spans, open in chrome://tracing or Perfetto
+	trace_dump("trace.json");
+#endif
+
+#ifdef VCS_LATENCY
+	// ns per call of every vcs operation over the whole run
+	for (int op = 0; op < OP_COUNT; op++) {
+	  latency_histogram h = vcs_latency(op);
+	  if (h.count())
+	    cerr << "lib_" << vcs_op_name(op) << "," << h.summary() << endl;
+	}
+#endif
+
 	if (errs != 0) {
 	  cout << "errs," << errs << endl;
 	  return 1;
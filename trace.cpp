@@ -0,0 +1,96 @@
+#include "trace.h"
+
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+
+struct trace_slot{
+	atomic<unsigned long long> seq; //0 while being written, else claim number+1
+	const char* name;
+	long long start, dur, arg;
+	int tid;
+};
+
+static trace_slot* slots(){
+	static trace_slot* s = new trace_slot[TRACE_CAPACITY](); //never freed, threads may still record at exit
+	return s;
+}
+
+static atomic<unsigned long long> next_slot(0);
+static atomic<bool> enabled(false);
+static atomic<int> next_tid(1);
+static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+static int thread_id(){
+	static thread_local int tid = next_tid.fetch_add(1);
+	return tid;
+}
+
+long long trace_now(){
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+void trace_start(){
+	slots();
+	enabled.store(true);
+}
+
+void trace_stop(){
+	enabled.store(false);
+}
+
+bool trace_enabled(){
+	return enabled.load(memory_order_relaxed);
+}
+
+void trace_record(const char* name, long long start_ns, long long dur_ns, long long arg){
+	unsigned long long k = next_slot.fetch_add(1, memory_order_relaxed);
+	trace_slot& s = slots()[k%TRACE_CAPACITY];
+
+	s.seq.store(0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	s.name = name;
+	s.start = start_ns;
+	s.dur = dur_ns;
+	s.arg = arg;
+	s.tid = thread_id();
+	s.seq.store(k+1, memory_order_release);
+}
+
+struct trace_event{
+	const char* name;
+	long long start, dur, arg;
+	int tid;
+};
+
+//meant for after the traced run; a slot that is rewritten while it is copied is skipped
+bool trace_dump(const string& filename){
+	trace_slot* s = slots();
+	vector<trace_event> events;
+	for(int i=0;i<TRACE_CAPACITY;i++){
+		unsigned long long seq = s[i].seq.load(memory_order_acquire);
+		if(seq==0)
+			continue;
+		trace_event e = {s[i].name, s[i].start, s[i].dur, s[i].arg, s[i].tid};
+		atomic_thread_fence(memory_order_acquire);
+		if(s[i].seq.load(memory_order_relaxed)==seq)
+			events.push_back(e);
+	}
+	sort(events.begin(), events.end(), [](const trace_event& a, const trace_event& b){ return a.start<b.start; });
+
+	ofstream out(filename);
+	out<<fixed;
+	out.precision(3);
+	out<<"{\"traceEvents\":[";
+	for(size_t i=0;i<events.size();i++){
+		trace_event& e = events[i];
+		out<<(i ? ",\n" : "\n")<<"{\"name\":\""<<e.name<<"\",\"cat\":\"vcs\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<e.tid
+		   <<",\"ts\":"<<e.start/1000.0<<",\"dur\":"<<e.dur/1000.0;
+		if(e.arg>=0)
+			out<<",\"args\":{\"n\":"<<e.arg<<"}";
+		out<<"}";
+	}
+	out<<"\n],\"displayTimeUnit\":\"ns\"}\n";
+	return (bool)out;
+}
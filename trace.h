@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <chrono>
+
+using namespace std;
+
+#define TRACE_CAPACITY (1<<18) //spans kept, the oldest are overwritten
+
+//scoped spans of the phases of keygen, key loading and verification, compiled in with -DVCS_TRACE and recorded
+//only between trace_start() and trace_stop(). spans go to a fixed ring buffer: a thread claims a slot with one
+//atomic increment and publishes it with the slot's sequence number, so recording never locks.
+//trace_dump writes the buffer as Chrome trace JSON, which chrome://tracing and Perfetto open.
+void trace_start();
+void trace_stop();
+bool trace_enabled();
+//name must outlive the dump, e.g. a string literal
+void trace_record(const char* name, long long start_ns, long long dur_ns, long long arg);
+bool trace_dump(const string& filename);
+
+long long trace_now();
+
+struct trace_span{
+	const char* name;
+	long long start, arg;
+
+	trace_span(const char* name, long long arg = -1){
+		this->name = name;
+		this->arg = arg;
+		start = trace_enabled() ? trace_now() : -1;
+	}
+	~trace_span(){
+		end();
+	}
+	//ends the span before the end of its scope
+	void end(){
+		if(start>=0)
+			trace_record(name, start, trace_now()-start, arg);
+		start = -1;
+	}
+};
+
+#ifdef VCS_TRACE
+#define TRACE_SPAN(name) trace_span trace_span_(name)
+#define TRACE_SPAN_ARG(name, arg) trace_span trace_span_(name, arg)
+#define TRACE_SPAN_BEGIN(var, name) trace_span var(name)
+#define TRACE_SPAN_END(var) var.end()
+#else
+#define TRACE_SPAN(name) do{}while(0)
+#define TRACE_SPAN_ARG(name, arg) do{}while(0)
+#define TRACE_SPAN_BEGIN(var, name) do{}while(0)
+#define TRACE_SPAN_END(var) do{}while(0)
+#endif
+
+#endif
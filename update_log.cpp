@@ -0,0 +1,75 @@
+#include "update_log.h"
+
+update_log::update_log(){
+	stub.next.store(NULL);
+	head.store(&stub);
+	tail = &stub;
+	tickets.store(0);
+}
+
+update_log::~update_log(){
+	update_record* r;
+	while((r = pop()) != NULL)
+		delete r;
+}
+
+void update_log::push(update_record* r){
+	r->next.store(NULL, memory_order_relaxed);
+	update_record* prev = head.exchange(r);
+	prev->next.store(r, memory_order_release);
+}
+
+long long update_log::append(long long index, const mpz_class& delta){
+	update_record* r = new update_record;
+	long long ticket = tickets.fetch_add(1, memory_order_relaxed)+1;
+	r->ticket = ticket;
+	r->index = index;
+	r->delta = delta;
+	push(r); //r belongs to the consumer from here on
+	return ticket;
+}
+
+long long update_log::appended() const{
+	return tickets.load();
+}
+
+//the stub keeps the queue non-empty for producers; it is skipped here and pushed again when the last record
+//would otherwise leave
+update_record* update_log::pop(){
+	update_record* t = tail;
+	update_record* next = t->next.load(memory_order_acquire);
+	if(t == &stub){
+		if(next == NULL)
+			return NULL;
+		tail = next;
+		t = next;
+		next = next->next.load(memory_order_acquire);
+	}
+	if(next != NULL){
+		tail = next;
+		return t;
+	}
+	if(t != head.load())
+		return NULL;
+	push(&stub);
+	next = t->next.load(memory_order_acquire);
+	if(next != NULL){
+		tail = next;
+		return t;
+	}
+	return NULL;
+}
+
+size_t update_log::drain(vector<update_record*>& out, size_t max){
+	size_t n = 0;
+	update_record* r;
+	while(n<max && (r = pop()) != NULL){
+		out.push_back(r);
+		n++;
+	}
+	return n;
+}
+
+bool update_log::empty() const{
+	return tail == &stub && head.load() == &stub;
+}
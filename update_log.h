@@ -0,0 +1,46 @@
+#ifndef UPDATE_LOG_H
+#define UPDATE_LOG_H
+
+#include <vector>
+#include <atomic>
+#include <gmp.h>
+#include <gmpxx.h>
+
+using namespace std;
+
+struct update_record{
+	atomic<update_record*> next;
+	long long ticket;
+	long long index;
+	mpz_class delta;
+};
+
+//multi-producer single-consumer log of (index, delta) updates, Vyukov's intrusive queue: append is one exchange
+//on the head and one store, whatever the number of producers, and never waits. the consumer reads from the
+//tail without touching the head except when the log looks empty.
+class update_log{
+	public:
+	update_log();
+	~update_log(); //deletes the records not drained
+
+	//any thread. tickets are 1, 2, ... in the order append was called; records reach the consumer in the order
+	//of their exchange, which may differ from their tickets for appends that ran at the same time
+	long long append(long long index, const mpz_class& delta);
+	long long appended() const;
+
+	//consumer only. moves up to max records to out in log order, the caller deletes them. a producer between its
+	//exchange and its store hides the records behind it until the next drain
+	size_t drain(vector<update_record*>& out, size_t max);
+	bool empty() const;
+
+	private:
+	atomic<update_record*> head; //last appended
+	update_record* tail; //next to drain, or &stub
+	update_record stub;
+	atomic<long long> tickets;
+
+	void push(update_record* r);
+	update_record* pop();
+};
+
+#endif
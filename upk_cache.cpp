@@ -0,0 +1,54 @@
+#include "upk_cache.h"
+
+//the low bits of a node are its position in the level, so neighbouring nodes spread over the segments
+static inline int segment(long long key){
+	return (key ^ (key>>17)) & (CACHE_SEGMENTS-1);
+}
+
+static inline long long node_key(int level, long long node){
+	return ((long long)level<<56) | node;
+}
+
+upk_cache::upk_cache(size_t node_capacity, size_t upk_capacity, int prefix_levels){
+	this->prefix_levels = prefix_levels;
+	for(int i=0;i<CACHE_SEGMENTS;i++){
+		nodes[i].capacity = (node_capacity+CACHE_SEGMENTS-1)/CACHE_SEGMENTS;
+		upks[i].capacity = (upk_capacity+CACHE_SEGMENTS-1)/CACHE_SEGMENTS;
+	}
+	node_hits = node_misses = upk_hits = upk_misses = 0;
+}
+
+bool upk_cache::get_node(int level, long long node, Ec1& value){
+	long long key = node_key(level,node);
+	bool hit = nodes[segment(key)].get(key,value);
+	if(hit)
+		node_hits++;
+	else
+		node_misses++;
+	return hit;
+}
+
+void upk_cache::put_node(int level, long long node, const Ec1& value){
+	long long key = node_key(level,node);
+	nodes[segment(key)].put(key,value);
+}
+
+bool upk_cache::get_upk(long long index, vector<Ec1>& upk){
+	bool hit = upks[segment(index)].get(index,upk);
+	if(hit)
+		upk_hits++;
+	else
+		upk_misses++;
+	return hit;
+}
+
+void upk_cache::put_upk(long long index, const vector<Ec1>& upk){
+	upks[segment(index)].put(index,upk);
+}
+
+void upk_cache::clear(){
+	for(int i=0;i<CACHE_SEGMENTS;i++){
+		nodes[i].clear();
+		upks[i].clear();
+	}
+}
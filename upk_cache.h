@@ -0,0 +1,100 @@
+#ifndef UPK_CACHE_H
+#define UPK_CACHE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "bn.h"
+#include "mem.h"
+
+using namespace std;
+using namespace bn;
+
+#define CACHE_SEGMENTS 16
+
+//sized LRU caches in front of the shard files: single prk nodes of the upper shard levels, which are shared by
+//many indices, and whole update keys of hot indices. both are split into segments with their own lock.
+//bytes of a cache entry, counted under MEM_UPK_CACHE (list and hash nodes not included)
+inline long long entry_bytes(const Ec1& v){
+	return sizeof(pair<long long,Ec1>);
+}
+inline long long entry_bytes(const vector<Ec1>& v){
+	return sizeof(pair<long long,vector<Ec1> >) + v.size()*sizeof(Ec1);
+}
+
+template< class V >
+class lru_segment{
+	public:
+	size_t capacity;
+	list<pair<long long,V> > items; //most recently used first
+	unordered_map<long long, typename list<pair<long long,V> >::iterator> pos;
+	mutex m;
+	
+	~lru_segment(){
+		for(auto it=items.begin();it!=items.end();it++)
+			mem_add(MEM_UPK_CACHE, -entry_bytes(it->second));
+	}
+	
+	bool get(long long key, V& value){
+		lock_guard<mutex> lock(m);
+		auto it = pos.find(key);
+		if(it==pos.end())
+			return false;
+		items.splice(items.begin(), items, it->second);
+		value = it->second->second;
+		return true;
+	}
+	
+	void clear(){
+		lock_guard<mutex> lock(m);
+		for(auto it=items.begin();it!=items.end();it++)
+			mem_add(MEM_UPK_CACHE, -entry_bytes(it->second));
+		items.clear();
+		pos.clear();
+	}
+	
+	void put(long long key, const V& value){
+		lock_guard<mutex> lock(m);
+		if(capacity==0)
+			return;
+		auto it = pos.find(key);
+		if(it!=pos.end()){
+			mem_add(MEM_UPK_CACHE, entry_bytes(value)-entry_bytes(it->second->second));
+			it->second->second = value;
+			items.splice(items.begin(), items, it->second);
+			return;
+		}
+		items.push_front(make_pair(key,value));
+		pos[key] = items.begin();
+		mem_add(MEM_UPK_CACHE, entry_bytes(value));
+		if(items.size()>capacity){
+			mem_add(MEM_UPK_CACHE, -entry_bytes(items.back().second));
+			pos.erase(items.back().first);
+			items.pop_back();
+		}
+	}
+};
+
+class upk_cache{
+	public:
+	upk_cache(size_t node_capacity, size_t upk_capacity, int prefix_levels);
+	
+	int prefix_levels; //shard levels lognfiles+1..lognfiles+prefix_levels are cached node by node
+	
+	bool get_node(int level, long long node, Ec1& value);
+	void put_node(int level, long long node, const Ec1& value);
+	bool get_upk(long long index, vector<Ec1>& upk);
+	void put_upk(long long index, const vector<Ec1>& upk);
+	//drops every entry; entries are only keyed by position, so this is needed whenever the keys change
+	void clear();
+	
+	atomic<unsigned long long> node_hits, node_misses, upk_hits, upk_misses;
+	
+	private:
+	lru_segment<Ec1> nodes[CACHE_SEGMENTS];
+	lru_segment<vector<Ec1> > upks[CACHE_SEGMENTS];
+};
+
+#endif
@@ -1,18 +1,67 @@
 #include "vcs.h"
+#include "glv.h"
+#include "ec1_batch.h"
+#include "stats.h"
+#include "trace.h"
+#include "mem.h"
 
 #include <cstring>
 #include <string>
-#include <cmath>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+#include <set>
+#include <iostream>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 
 #define ncore 16
-#define nfiles 8
-#define lognfiles 3
+#define MAX_OPEN_SHARDS 64
+#define COMMIT_CHUNK 65536
+#define EXP_BATCH 256 //nodes per pre_exp_batch call in keygen
 
-string path = "pkvk/";
+//key files are opened through here and the pairing below so that -DVCS_STATS can count them
+static int open_key(const string& filename){
+	STAT_ADD(STAT_FILES_OPENED, 1);
+	return open_key_file(filename);
+}
+
+//pwrite until all n bytes are written, false on an error
+static bool pwrite_all(int fd, const void* buf, size_t n, long long offset){
+	size_t done = 0;
+	while(done<n){
+		ssize_t k = pwrite(fd, (const char*)buf+done, n-done, offset+done);
+		if(k<0 && errno==EINTR)
+			continue;
+		if(k<=0)
+			return false;
+		done += k;
+	}
+	return true;
+}
+
+//adds a finished shard to a keygen manifest
+static bool append_manifest(const string& filename, int batch){
+	ofstream ManifestFile(filename, ios::out | ios::app);
+	ManifestFile<<batch<<endl;
+	ManifestFile.close();
+	if(!ManifestFile){
+		cerr<<"keygen: cannot write "<<filename<<endl;
+		return false;
+	}
+	return true;
+}
+
+//opt_atePairing runs the Miller loop and the final exponentiation
+static inline void pairing(Fp12& e, const Ec2& Q, const Ec1& P){
+	TRACE_SPAN("pairing");
+	STAT_ADD(STAT_PAIRINGS, 1);
+	opt_atePairing(e,Q,P);
+}
 
-vector<bool> to_binary(int index, int L){ //LSB first
+vector<bool> to_binary(long long index, int L){ //LSB first
 	vector<bool> binary(L);
 	for(int i=0;i<L;i++){
 		binary[i] = index%2;
@@ -23,11 +72,13 @@ vector<bool> to_binary(int index, int L){ //LSB first
 
 
 void precompute_g1(Ec1 g1, vector<Ec1>& g1_pre, int P){
+	TRACE_SPAN("keygen.precompute_g1");
 	g1_pre.resize(P);
 	g1_pre[0] = g1;
 	for(int i=1;i<P;i++){
 		g1_pre[i]=g1_pre[i-1]+g1_pre[i-1];
 	}
+	STAT_ADD(STAT_POINT_DBLS, P-1);
 	return;
 }
 
@@ -47,11 +98,24 @@ T pre_exp(vector<T>& pre, mpz_class n){
 
 }
 
+template< class T >
+T pre_exp(vector<T>& pre, const fr_t& n){
+	T temp = pre[0]*0;
+	int length = fr_bits(n);
+
+	for(int i=0;i<length;i++){
+		if(fr_tstbit(n,i))
+			temp = temp + pre[i];
+	}
+	
+	return temp;
+}
+
 
 vcs::vcs(int d, mpz_class p, Ec1 g1, Ec2 g2){
 	
 	L = d;
-	N = (int)pow(2,L);
+	N = (long long)1<<L;
 	
 	
 	this->p = p;
@@ -60,184 +124,272 @@ vcs::vcs(int d, mpz_class p, Ec1 g1, Ec2 g2){
 	
 	this->g1 = g1;
 	this->g2 = g2;
+	ec1_table_init(g1_table,g1);
+	
+	path = "pkvk/";
+	set_layout(L<3 ? L : 3,path,LAYOUT_LEVEL);
+	cache = NULL;
+	readers = NULL;
 }
 
-vcs::~vcs(){}
+vcs::~vcs(){
+	delete cache;
+	delete readers;
+}
 
-void vcs::keygen(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
-	
-	unsigned long int seed;
-	gmp_randstate_t r_state;
-	short size = sizeof(seed);
-	ifstream urandom("/dev/urandom", ios::in|ios::binary);
-	urandom.read((char*)&seed,size);
-	urandom.close();
-	
-	
-    gmp_randinit_default (r_state);
-    gmp_randseed_ui(r_state, seed);
-	
-	
-	
-	vector<Ec1> g1_pre;
-	precompute_g1(g1, g1_pre,P);
-	
-	//secret keys
-	vector<mpz_class> s(L);
-	
-	for(int i=0;i<L;i++)
-		mpz_urandomm(s[i].get_mpz_t(),r_state,p.get_mpz_t());
-	
-	
-	
-	//compute public keys
-	
-	prk.resize(L+1);
-	vrk.resize(L);
+//caches up to node_entries prk nodes of the first prefix_levels shard levels and the update keys of up to upk_entries indices
+void vcs::enable_cache(size_t node_entries, size_t upk_entries, int prefix_levels){
+	delete cache;
+	cache = new upk_cache(node_entries, upk_entries, prefix_levels);
+}
 
-	
-	for(int i=0;i<L+1;i++){
-		if(i>lognfiles)
-			prk[i].resize((int)pow(2,i-lognfiles));
-		else
-			prk[i].resize((int)pow(2,i));
+void vcs::disable_cache(){
+	delete cache;
+	cache = NULL;
+}
+
+//out[k] = pre_exp(pre,n[k]) for k < count. for each bit, the additions into the nodes that have it set are
+//independent and go through ec1_add_batch together
+void pre_exp_batch(vector<Ec1>& pre, const fr_t* n, int count, Ec1* out){
+	vector<bool> started(count,false);
+	vector<int> sel;
+	vector<Ec1> acc, add;
+	
+	int bits = 0;
+	for(int k=0;k<count;k++){
+		bits = max(bits,fr_bits(n[k]));
+		out[k] = pre[0]*0;
 	}
 	
-	prk[0][0] = g1;
-	
-	
-	
-	vector<vector<mpz_class> > vars(L+1);
-	for(int i=0;i<L+1;i++){
-		if(i>lognfiles)
-			vars[i].resize((int)pow(2,i-lognfiles));
-		else
-			vars[i].resize((int)pow(2,i));
+	for(int i=0;i<bits;i++){
+		sel.clear();
+		for(int k=0;k<count;k++){
+			if(!fr_tstbit(n[k],i))
+				continue;
+			if(started[k])
+				sel.push_back(k);
+			else{
+				out[k] = pre[i];
+				started[k] = true;
+			}
+		}
+		
+		acc.resize(sel.size());
+		add.assign(sel.size(),pre[i]);
+		for(int m=0;m<sel.size();m++)
+			acc[m] = out[sel[m]];
+		ec1_add_batch(acc.data(),acc.data(),add.data(),sel.size());
+		for(int m=0;m<sel.size();m++)
+			out[sel[m]] = acc[m];
 	}
-	
-
-	
-	vars[0][0]=1;
+}
 
+//one level of the prk tree: vars_next/prk_next get the two children of every node in vars/prk_prev
+void expand_level(vector<fr_t>& vars, vector<Ec1>& prk_prev, vector<fr_t>& vars_next, vector<Ec1>& prk_next, fr_t s, fr_t p, vector<Ec1>& g1_pre){
+	TRACE_SPAN_ARG("keygen.level", 2*vars.size());
+	
+	fr_t one, s_neg;
+	fr_set_ui(one,1);
+	fr_sub(s_neg,one,s,p);
+	
+	vars_next.resize(2*vars.size());
+	prk_next.resize(2*vars.size());
+	
+	auto f = [](long long x, long long y, fr_t s, fr_t s_neg, fr_t p, vector<Ec1>* g1_pre, vector<fr_t>* vars, vector<Ec1>* prk_prev, vector<fr_t>* vars_next, vector<Ec1>* prk_next) {
+		TRACE_SPAN_ARG("keygen.level_worker", y-x);
+		vector<fr_t> odd(EXP_BATCH);
+		vector<Ec1> prk_odd(EXP_BATCH);
+        for (long long j0 = x; j0 < y; j0 += EXP_BATCH){
+			long long j1 = min(y, j0+EXP_BATCH);
+			for (long long j = j0; j < j1; j++){
+				fr_mul((*vars_next)[2*j+1],(*vars)[j],s,p);
+				fr_mul((*vars_next)[2*j],(*vars)[j],s_neg,p);
+				odd[j-j0] = (*vars_next)[2*j+1];
+			}
+			
+			pre_exp_batch(*g1_pre,odd.data(),j1-j0,prk_odd.data());
+			for (long long j = j0; j < j1; j++){
+				(*prk_next)[2*j+1] = prk_odd[j-j0];
+				(*prk_next)[2*j] = ec1_sub((*prk_prev)[j],(*prk_next)[2*j+1]);
+			}
+		}
+    };
 	
+	long long total_size = vars.size();
 	
-	for(int i=1;i<lognfiles+1;i++){
-		for(int j=0;j<(int)pow(2,i-1);j++){
-			vars[i][2*j+1] = (vars[i-1][j]*s[i-1])%p;			
-			vars[i][2*j] = (vars[i-1][j]*(1-s[i-1]))%p;
-		}
+	if(total_size<ncore){
+		f(0,total_size,s,s_neg,p,&g1_pre,&vars,&prk_prev,&vars_next,&prk_next);
+		return;
 	}
 	
-	
-	for(int i=1;i<lognfiles+1;i++){
-		for(int j=0;j<(int)pow(2,i-1);j++){
-				
-			if(vars[i][2*j+1]<0)
-				vars[i][2*j+1]+=p;
-
-				
-			prk[i][2*j+1] = pre_exp(g1_pre,vars[i][2*j+1]);
-			prk[i][2*j] = prk[i-1][j]-prk[i][2*j+1];
-			
-			
-		}
-		
+	thread th[ncore];
+	for(int k=0;k<ncore;k++)
+		th[k]=thread(f,total_size/ncore*k, total_size/ncore*(k+1),s,s_neg,p,&g1_pre,&vars,&prk_prev,&vars_next,&prk_next);
 		
+	for(int k=0;k<ncore;k++)
+		th[k].join();
+}
+
+//the secrets of an unfinished keygen, kept so that an interrupted run can resume. it is a trapdoor, so it is private to the user and removed once all shards are written.
+bool vcs::load_keygen_state(vector<fr_t>& s){
+	ifstream InFile;
+	string filename = path+"keygen.state";
+	InFile.open(filename, ios::in | ios::binary);
+	if(!InFile)
+		return false;
+	
+	int header[5];
+	InFile.read((char*)header, sizeof(header));
+	string sp(InFile && header[4]>=0 && header[4]<=4096 ? header[4] : 0, ' ');
+	if(!sp.empty())
+		InFile.read(&sp[0], sp.size());
+	s.resize(L);
+	InFile.read((char*)&s[0], L*sizeof(fr_t));
+	if(!InFile){
+		cerr<<"load_keygen_state: "<<filename<<" is truncated"<<endl;
+		return false;
 	}
 	
-	auto f = [](int i, int x, int y, mpz_class p, vector<Ec1>* g1_pre, vector<vector<mpz_class> >* vars, vector<vector<Ec1> >* prk) {
-        for (int j = x; j < y; j++){
-			if((*vars)[i][2*j+1]<0)
-				(*vars)[i][2*j+1]+=p;
+	//the manifest only means something for the key set the secrets were sampled for
+	if(header[0]!=L || header[1]!=nfiles || header[2]!=layout || header[3]!=block_height || sp!=shard_path){
+		cerr<<"load_keygen_state: "<<filename<<" is for L="<<header[0]<<", "<<header[1]<<" shards in "<<sp<<", layout "<<header[2]<<", block_height "<<header[3]<<". resume with the same layout or remove it to start over"<<endl;
+		return false;
+	}
+	return true;
+}
 
-				
-			(*prk)[i][2*j+1] = pre_exp(*g1_pre,(*vars)[i][2*j+1]);
-			(*prk)[i][2*j] = (*prk)[i-1][j]-(*prk)[i][2*j+1];
-		
-		}
-    };
+//written to keygen.state.tmp and renamed, so a crash leaves no torn state behind
+bool vcs::save_keygen_state(vector<fr_t>& s){
+	string filename = path+"keygen.state";
+	string tmp = filename+".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd<0){
+		cerr<<"save_keygen_state: cannot create "<<tmp<<endl;
+		return false;
+	}
 	
+	int header[5] = {L, nfiles, layout, block_height, (int)shard_path.size()};
+	bool ok = write(fd, header, sizeof(header))==(ssize_t)sizeof(header)
+		&& write(fd, shard_path.data(), shard_path.size())==(ssize_t)shard_path.size()
+		&& write(fd, &s[0], L*sizeof(fr_t))==(ssize_t)(L*sizeof(fr_t))
+		&& fsync(fd)==0;
+	ok = close(fd)==0 && ok;
+	if(!ok || rename(tmp.c_str(), filename.c_str())!=0){
+		cerr<<"save_keygen_state: cannot write "<<filename<<endl;
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
 
-	for(int batch = 0; batch < nfiles; batch++){
-		
-		
-		vars[lognfiles+1][1] = (vars[lognfiles][batch]*s[lognfiles])%p;			
-		vars[lognfiles+1][0] = (vars[lognfiles][batch]*(1-s[lognfiles]))%p;
+//the manifest lists the shards that are completely on disk, one batch number per line
+void vcs::read_manifest(string filename, vector<bool>& done){
+	ifstream InFile(filename);
+	int batch;
+	while(InFile>>batch){
+		if(batch>=0 && batch<nfiles)
+			done[batch] = true;
+	}
+}
 
-		
-		for(int i=lognfiles+2;i<L+1;i++){
-			
-			for(int j=0;j<(int)pow(2,i-1-lognfiles);j++){
-				vars[i][2*j+1] = (vars[i-1][j]*s[i-1])%p;			
-				vars[i][2*j] = (vars[i-1][j]*(1-s[i-1]))%p;
-			}
-		}
-		
-		if(vars[lognfiles+1][1]<0)
-			vars[lognfiles+1][1]+=p;
-					
-		prk[lognfiles+1][1] = pre_exp(g1_pre,vars[lognfiles+1][1]);
-		prk[lognfiles+1][0] = prk[lognfiles][batch]-prk[lognfiles+1][1];
-				
+void vcs::keygen_top(vector<fr_t>& s, vector<Ec1>& g1_pre, vector<vector<Ec1> >& prk, vector<fr_t>& vars){
+	TRACE_SPAN("keygen.top");
+	fr_t pr;
+	fr_set(pr,p);
 	
-		
-		for(int i=lognfiles+2;i<lognfiles+(int)log2(ncore)+1;i++){
-			for(int j=0;j<(int)pow(2,i-1-lognfiles);j++){
-					
-				if(vars[i][2*j+1]<0)
-					vars[i][2*j+1]+=p;
-
-					
-				prk[i][2*j+1] = pre_exp(g1_pre,vars[i][2*j+1]);
-				prk[i][2*j] = prk[i-1][j]-prk[i][2*j+1];
-				
-				
-			}
-		
-		
-		}
-		
-		thread th[ncore];
+	prk.resize(lognfiles+1);
+	prk[0].resize(1);
+	prk[0][0] = g1;
 	
-		for(int i=lognfiles+(int)log2(ncore)+1;i<L+1;i++){
+	vars.resize(1);
+	fr_set_ui(vars[0],1);
+	
+	mem_tracker vars_mem(MEM_VARS);
+	long long prk_bytes = sizeof(Ec1);
+	for(int i=1;i<lognfiles+1;i++){
+		vector<fr_t> vars_next;
+		expand_level(vars,prk[i-1],vars_next,prk[i],s[i-1],pr,g1_pre);
+		vars_mem.set((vars.size()+vars_next.size())*sizeof(fr_t));
+		prk_bytes += prk[i].size()*sizeof(Ec1);
+		mem_set(MEM_PRK, prk_bytes);
+		vars.swap(vars_next);
+	}
+}
 
-			int total_size = (int)pow(2,i-1-lognfiles);
-			for(int k=0;k<ncore;k++)
-				th[k]=thread(f,i,total_size/ncore*k, total_size/ncore*(k+1),p ,&g1_pre, &vars, &prk);
-				
-			for(int k=0;k<ncore;k++)
-				th[k].join();	
-				
+//streams the subtree below prk[lognfiles][batch] to pk<batch>.txt one level at a time, so only two levels of one shard are in memory.
+//the shard is written to pk<batch>.txt.tmp, synced and renamed, so pk<batch>.txt is either complete or absent
+bool vcs::keygen_shard(int batch, vector<fr_t>& s, vector<Ec1>& g1_pre, fr_t root_var, Ec1 root_prk){
+	TRACE_SPAN_ARG("keygen.shard", batch);
+	if(L==lognfiles)
+		return true;
+	
+	fr_t pr;
+	fr_set(pr,p);
+	
+	vector<fr_t> vars(1,root_var), vars_next;
+	vector<Ec1> prk(1,root_prk), prk_next;
+	
+	string filename = shard_file(batch);
+	string tmp = filename+".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if(fd<0){
+		cerr<<"keygen_shard: cannot create "<<tmp<<endl;
+		return false;
+	}
+	bool ok = true;
+	
+	mem_tracker vars_mem(MEM_VARS), levels_mem(MEM_SHARD_LEVELS);
+	for(int i=lognfiles+1;i<L+1 && ok;i++){
+		expand_level(vars,prk,vars_next,prk_next,s[i-1],pr,g1_pre);
+		vars_mem.set((vars.capacity()+vars_next.capacity())*sizeof(fr_t));
+		levels_mem.set((prk.capacity()+prk_next.capacity())*sizeof(Ec1));
 		
-				
+		//each run of shard_run(i) consecutive nodes is contiguous on disk
+		{
+			TRACE_SPAN_ARG("keygen.shard_write", i);
+			long long run = shard_run(i);
+			for(long long k=0;k<prk_next.size() && ok;k+=run)
+				ok = pwrite_all(fd, &prk_next[k], run*sizeof(Ec1), shard_offset(i,k));
 		}
 		
-		mkdir(path.c_str(),S_IRWXU);
-		
-		ofstream OutFile;
-		string filename = path+"pk"+to_string(batch)+".txt";
-		
-		
-		
-		OutFile.open(filename, ios::out | ios::binary);
-		
-		
-		
-		for(int i= lognfiles+1; i<L+1;i++){
-			for(int j=0;j<prk[i].size();j++){
-				OutFile.write( (char*)&prk[i][j], sizeof(Ec1));
-			
-			}
-		}
-		
-		OutFile.close();
-	
+		vars.swap(vars_next);
+		prk.swap(prk_next);
 	}
 	
-	for(int i=lognfiles+1;i<L+1;i++){
-		prk[i].resize(0);
+	ok = ok && fsync(fd)==0;
+	ok = close(fd)==0 && ok;
+	if(!ok || rename(tmp.c_str(), filename.c_str())!=0){
+		cerr<<"keygen_shard: cannot write "<<filename<<endl;
+		remove(tmp.c_str());
+		return false;
 	}
+	return true;
+}
+
+void vcs::sample_secrets(vector<fr_t>& s){
+	TRACE_SPAN("keygen.sample_secrets");
+	unsigned long int seed;
+	gmp_randstate_t r_state;
+	short size = sizeof(seed);
+	ifstream urandom("/dev/urandom", ios::in|ios::binary);
+	urandom.read((char*)&seed,size);
+	urandom.close();
 	
+	gmp_randinit_default (r_state);
+	gmp_randseed_ui(r_state, seed);
+	
+	s.resize(L);
+	for(int i=0;i<L;i++){
+		mpz_class temp;
+		mpz_urandomm(temp.get_mpz_t(),r_state,p.get_mpz_t());
+		fr_set(s[i],temp);
+	}
+	gmp_randclear(r_state);
+}
+
+//writes pk.txt (levels 0..lognfiles) and vrk.txt
+bool vcs::save_key(vector<fr_t>& s, vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
+	TRACE_SPAN("keygen.save_key");
 	ofstream OutFile;
 	string filename = path+"pk.txt";
 	OutFile.open(filename, ios::out | ios::binary);
@@ -252,11 +404,15 @@ void vcs::keygen(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
 	}
 	
 	OutFile.close();
+	if(!OutFile){
+		cerr<<"save_key: cannot write "<<filename<<endl;
+		return false;
+	}
 	
 	
-	
+	vrk.resize(L);
 	for(int i=0;i<L;i++){
-		const mie::Vuint temp((s[i].get_str()).c_str());
+		const mie::Vuint temp((fr_get(s[i]).get_str()).c_str());
 		vrk[i]=g2*temp;
 	}
 	
@@ -270,55 +426,399 @@ void vcs::keygen(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
 	}
 	
 	OutFile.close();
+	if(!OutFile){
+		cerr<<"save_key: cannot write "<<filename<<endl;
+		return false;
+	}
+	return true;
+}
+
+bool vcs::keygen(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
+	TRACE_SPAN("keygen");
+	if(cache!=NULL)
+		cache->clear();
 	
+	mkdir(path.c_str(),S_IRWXU);
+	mkdir(shard_path.c_str(),S_IRWXU);
 	
-	/*
-	upk.resize(N);
+	//secret keys
+	vector<fr_t> s(L);
+	vector<bool> done(nfiles,false);
 	
-	for(int i=0;i<N;i++){
-		upk[i].resize(L);
-		for(int j=L-1;j>=0;j--){
-			upk[i][j] = prk[j+1][i>>(L-j-1)];
-		}
-	} */
+	string manifest = path+"manifest.txt";
 	
-	return;
+	struct stat st;
+	if(stat((path+"keygen.state").c_str(), &st)==0){
+		if(!load_keygen_state(s))
+			return false;
+		read_manifest(manifest, done);
+	}
+	else{
+		sample_secrets(s);
+		remove(manifest.c_str());
+		if(!save_keygen_state(s))
+			return false;
+	}
+	
+	
+	vector<Ec1> g1_pre;
+	precompute_g1(g1, g1_pre,P);
+	
+	//compute public keys
+	
+	vector<fr_t> vars;
+	keygen_top(s,g1_pre,prk,vars);
+	
+	for(int batch = 0; batch < nfiles; batch++){
+		if(done[batch])
+			continue;
+		
+		if(!keygen_shard(batch,s,g1_pre,vars[batch],prk[lognfiles][batch]) || !append_manifest(manifest, batch))
+			return false;
+	}
+	
+	if(!save_key(s,prk,vrk) || !save_header())
+		return false;
+	
+	//every shard is on disk, the secrets are no longer needed
+	remove((path+"keygen.state").c_str());
+	remove(manifest.c_str());
+	
+	return true;
 }
 
-void vcs::load_key(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
-	prk.resize(lognfiles+1);
-	vrk.resize(L);
+//multi-process keygen. keygen_root writes pk.txt, vrk.txt and root.txt, which holds only what the shards need:
+//vars at level lognfiles and the secrets s[lognfiles..L-1]. it is still trapdoor material and is removed by keygen_merge.
+bool vcs::keygen_root(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
+	if(cache!=NULL)
+		cache->clear();
+	
+	mkdir(path.c_str(),S_IRWXU);
+	mkdir(shard_path.c_str(),S_IRWXU);
+	
+	vector<fr_t> s;
+	sample_secrets(s);
+	
+	vector<Ec1> g1_pre;
+	precompute_g1(g1, g1_pre,P);
+	
+	vector<fr_t> vars;
+	keygen_top(s,g1_pre,prk,vars);
+	
+	if(!save_key(s,prk,vrk) || !save_header())
+		return false;
+	
+	string filename = path+"root.txt";
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd<0){
+		cerr<<"keygen_root: cannot create "<<filename<<endl;
+		return false;
+	}
+	
+	int header[2] = {L, nfiles};
+	long long offset = sizeof(header);
+	bool ok = pwrite_all(fd, header, sizeof(header), 0)
+		&& pwrite_all(fd, &vars[0], nfiles*sizeof(fr_t), offset)
+		&& pwrite_all(fd, &s[lognfiles], (L-lognfiles)*sizeof(fr_t), offset+nfiles*sizeof(fr_t))
+		&& fsync(fd)==0;
+	ok = close(fd)==0 && ok;
+	if(!ok){
+		cerr<<"keygen_root: cannot write "<<filename<<endl;
+		remove(filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+//generates the shards batch = worker, worker+nworkers, ... from root.txt and pk.txt. each worker keeps its own manifest, so a killed worker resumes where it stopped.
+bool vcs::keygen_worker(int worker, int nworkers){
+	if(nworkers<=0 || worker<0 || worker>=nworkers){
+		cerr<<"keygen_worker: worker "<<worker<<" is not in [0,"<<nworkers<<")"<<endl;
+		return false;
+	}
+	
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	if(!load_key(prk,vrk))
+		return false;
+	mkdir(shard_path.c_str(),S_IRWXU);
 	
 	ifstream InFile;
-	string filename = path+"pk.txt";
+	string filename = path+"root.txt";
 	InFile.open(filename, ios::in | ios::binary);
+	int header[2];
+	InFile.read((char*)header, sizeof(header));
+	if(!InFile || header[0]!=L || header[1]!=nfiles){
+		cerr<<"keygen_worker: cannot read "<<filename<<" for L="<<L<<" and "<<nfiles<<" shards"<<endl;
+		return false;
+	}
+	
+	vector<fr_t> vars(nfiles), s(L);
+	InFile.read((char*)&vars[0], nfiles*sizeof(fr_t));
+	InFile.read((char*)&s[lognfiles], (L-lognfiles)*sizeof(fr_t));
+	if(!InFile){
+		cerr<<"keygen_worker: "<<filename<<" is truncated"<<endl;
+		return false;
+	}
+	InFile.close();
 	
+	vector<Ec1> g1_pre;
+	precompute_g1(g1, g1_pre,P);
 	
-	for(int k=0 ; k<lognfiles+1;k++){
-		prk[k].resize((int)pow(2,k));
-		for(int t=0;t<prk[k].size();t++){
-			InFile.read( (char*)&prk[k][t], sizeof(Ec1));
+	vector<bool> done(nfiles,false);
+	string manifest = path+"manifest"+to_string(worker)+".txt";
+	read_manifest(manifest, done);
+	
+	for(int batch = worker; batch < nfiles; batch+=nworkers){
+		if(done[batch])
+			continue;
+		
+		if(!keygen_shard(batch,s,g1_pre,vars[batch],prk[lognfiles][batch]) || !append_manifest(manifest, batch))
+			return false;
+	}
+	
+	return true;
+}
+
+//checks that every shard is present, has the right size and hangs below its node in pk.txt, then removes root.txt and the worker manifests.
+//a shard only gets its name once keygen_shard wrote and synced all of it; the size catches one that was copied over partially
+bool vcs::keygen_merge(int nworkers){
+	if(nworkers<=0){
+		cerr<<"keygen_merge: nworkers must be positive, not "<<nworkers<<endl;
+		return false;
+	}
+	
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	if(!load_key(prk,vrk))
+		return false;
+	
+	for(int batch = 0; batch < nfiles && L > lognfiles; batch++){
+		string filename = shard_file(batch);
+		
+		struct stat st;
+		if(stat(filename.c_str(), &st)!=0 || st.st_size != shard_size()){
+			cerr<<"keygen_merge: "<<filename<<" is missing or incomplete"<<endl;
+			return false;
+		}
 		
+		Ec1 children[2];
+		ifstream InFile;
+		InFile.open(filename, ios::in | ios::binary);
+		for(int k=0;k<2;k++){
+			InFile.seekg(shard_offset(lognfiles+1,k));
+			InFile.read((char*)&children[k], sizeof(Ec1));
+		}
+		InFile.close();
+		
+		if(!(ec1_add(children[0],children[1]) == prk[lognfiles][batch])){
+			cerr<<"keygen_merge: "<<filename<<" does not match pk.txt"<<endl;
+			return false;
 		}
 	}
 	
-	InFile.close();
+	remove((path+"root.txt").c_str());
+	for(int w=0;w<nworkers;w++)
+		remove((path+"manifest"+to_string(w)+".txt").c_str());
 	
-	filename = path+"vrk.txt";
-	InFile.open(filename, ios::in | ios::binary);
+	return true;
+}
+
+//the key-set header records how the keys below the top lognfiles levels are split into shard files
+bool vcs::set_layout(int lognfiles, string shard_path, int layout, int block_height){
+	if(lognfiles<0 || lognfiles>L || (layout!=LAYOUT_LEVEL && layout!=LAYOUT_BLOCKED) || block_height<1){
+		cerr<<"set_layout: lognfiles "<<lognfiles<<", layout "<<layout<<", block_height "<<block_height<<" is not a layout for L="<<L<<endl;
+		return false;
+	}
+	this->lognfiles = lognfiles;
+	nfiles = 1<<lognfiles;
+	this->shard_path = shard_path.empty() ? path : shard_path;
+	if(this->shard_path.empty() || this->shard_path[this->shard_path.size()-1]!='/')
+		this->shard_path += '/'; //shard_file appends the name directly
+	this->layout = layout;
+	this->block_height = block_height;
+	return true;
+}
+
+bool vcs::save_header(){
+	ofstream OutFile(path+"header.txt");
+	OutFile<<"L "<<L<<endl;
+	OutFile<<"lognfiles "<<lognfiles<<endl;
+	OutFile<<"layout "<<layout<<endl;
+	OutFile<<"block_height "<<block_height<<endl;
+	OutFile<<"shard_path "<<shard_path<<endl;
+	OutFile.close();
+	if(!OutFile){
+		cerr<<"save_header: cannot write "<<path<<"header.txt"<<endl;
+		return false;
+	}
+	return true;
+}
+
+bool vcs::load_header(){
+	ifstream InFile(path+"header.txt");
+	if(!InFile)
+		return false;
+	
+	string key;
+	int d = -1, k = lognfiles, lay = layout, h = block_height;
+	string sp = shard_path;
+	while(InFile>>key){
+		if(key=="L")
+			InFile>>d;
+		else if(key=="lognfiles")
+			InFile>>k;
+		else if(key=="layout")
+			InFile>>lay;
+		else if(key=="block_height")
+			InFile>>h;
+		else if(key=="shard_path"){
+			//the rest of the line, spaces included
+			getline(InFile,sp);
+			if(!sp.empty() && sp[0]==' ')
+				sp.erase(0,1);
+		}
+	}
+	if(!InFile.eof()){
+		cerr<<"load_header: cannot parse "<<path<<"header.txt"<<endl;
+		return false;
+	}
+	
+	if(d!=L){
+		cerr<<"load_header: key set in "<<path<<" is for L="<<d<<", not "<<L<<endl;
+		return false;
+	}
+	
+	return set_layout(k,sp,lay,h);
+}
+
+//LAYOUT_BLOCKED cuts the subtree of a shard into bands of block_height levels. every node at the top of a band
+//owns a block holding its descendants in the band, stored level by level and padded to whole pages,
+//so the path of one index touches ceil((L-lognfiles)/block_height) blocks instead of L-lognfiles pages.
+long long vcs::block_stride(int height){
+	long long bytes = (((long long)1<<(height+1)) - 2)*sizeof(Ec1);
+	return (bytes+PAGE_BYTES-1)/PAGE_BYTES*PAGE_BYTES;
+}
+
+//byte offset of prk[level][keynum] inside its shard, level > lognfiles and keynum relative to the shard
+long long vcs::shard_offset(int level, long long keynum){
+	int d = level-lognfiles;
+	
+	if(layout!=LAYOUT_BLOCKED)
+		return (((long long)1<<d) - 2 + keynum)*(long long)sizeof(Ec1);
+	
+	int h = block_height, H = L-lognfiles;
+	int band = (d-1)/h, t = d-band*h;
+	int band_height = (H-band*h)<h ? H-band*h : h;
+	
+	long long band_start = 0;
+	for(int b=0;b<band;b++)
+		band_start += ((long long)1<<(b*h))*block_stride(h);
+	
+	long long block = keynum>>t, q = keynum & (((long long)1<<t)-1);
+	
+	return band_start + block*block_stride(band_height) + (((long long)1<<t) - 2 + q)*(long long)sizeof(Ec1);
+}
+
+//number of consecutive nodes of a level that are contiguous in the shard
+long long vcs::shard_run(int level){
+	int d = level-lognfiles;
 	
+	if(layout!=LAYOUT_BLOCKED)
+		return (long long)1<<d;
 	
-	for(int k=0 ; k<L;k++){
-		InFile.read( (char*)&vrk[k], sizeof(Ec2));
+	return (long long)1<<(d-(d-1)/block_height*block_height);
+}
+
+long long vcs::shard_size(){
+	if(L==lognfiles)
+		return 0;
+	
+	int d = L-lognfiles;
+	long long keynum = ((long long)1<<d)-1;
+	return shard_offset(L,keynum)+sizeof(Ec1);
+}
+
+bool vcs::load_key(vector<vector<Ec1> >& prk, vector<Ec2>& vrk){
+	TRACE_SPAN("load_key");
+	if(cache!=NULL)
+		cache->clear();
+	if(!load_header())
+		return false;
+	
+	prk.resize(lognfiles+1);
+	vrk.resize(L);
+	
+	key_reader& reader = thread_reader();
+	
+	int fd = open_key(path+"pk.txt");
+	long long offset = 0;
+	for(int k=0 ; k<lognfiles+1;k++){
+		prk[k].resize(1<<k);
+		reader.read(fd, offset, &prk[k][0], prk[k].size()*sizeof(Ec1));
+		offset += prk[k].size()*sizeof(Ec1);
 	}
+	mem_set(MEM_PRK, offset);
 	
-	InFile.close();
-	return;
+	int vrk_fd = open_key(path+"vrk.txt");
+	reader.read(vrk_fd, 0, &vrk[0], L*sizeof(Ec2));
+	
+	bool ok = reader.submit();
+	
+	close(fd);
+	close(vrk_fd);
+	if(!ok)
+		cerr<<"load_key: cannot read pk.txt and vrk.txt in "<<path<<endl;
+	return ok;
 
 }
 
+void vcs::evict_keys(){
+	evict_file(path+"pk.txt");
+	evict_file(path+"vrk.txt");
+	for(int i=0;i<nfiles;i++)
+		evict_file(shard_file(i));
+}
+
+string vcs::shard_file(long long filenum){
+	return shard_path+"pk"+to_string(filenum)+".txt";
+}
+
+//queues the reads of levels lognfiles..L-1 of the update key of index from its (open) shard; they are done by reader.submit()
+void vcs::read_path(key_reader& reader, int fd, long long index, vector<Ec1>& upk){
+	for(int j=L-1;j>=lognfiles;j--){
+		long long keynum = (index >> (L-j-1)) & (((long long)1<<(j+1-lognfiles))-1);
+		long long node = index >> (L-j-1);
+		
+		bool cached = cache!=NULL && j+1<=lognfiles+cache->prefix_levels;
+		if(cached && cache->get_node(j+1, node, upk[j]))
+			continue;
+		
+		if(cached){
+			upk_cache* c = cache;
+			Ec1* point = &upk[j];
+			reader.read(fd, shard_offset(j+1,keynum), point, sizeof(Ec1), [c,j,node,point](){ c->put_node(j+1, node, *point); });
+		}
+		else
+			reader.read(fd, shard_offset(j+1,keynum), &upk[j], sizeof(Ec1));
+	}
+}
+
+//asks the kernel to start reading the pages of a path in the background
+void vcs::prefetch_path(int fd, long long index){
+	for(int j=L-1;j>=lognfiles;j--){
+		long long keynum = (index >> (L-j-1)) & (((long long)1<<(j+1-lognfiles))-1);
+		posix_fadvise(fd, shard_offset(j+1,keynum), sizeof(Ec1), POSIX_FADV_WILLNEED);
+	}
+}
+
 vector<Ec1> vcs::calc_update_key(long long int index, vector<vector<Ec1> >& prk){
+	LATENCY_SCOPE(OP_CALC_UPDATE_KEY);
     vector<Ec1> upk;
+	
+	if(cache!=NULL && cache->get_upk(index,upk))
+		return upk;
+	
     upk.resize(L);
 	
 	
@@ -326,46 +826,36 @@ vector<Ec1> vcs::calc_update_key(long long int index, vector<vector<Ec1> >& prk)
     	upk[j] = prk[j+1][index >> (L-j-1)];
     }
 	
+	if(L==lognfiles)
+		return upk;
+	
+	//all levels below lognfiles of one index live in the same shard
+	key_reader& reader = thread_reader();
+	int fd = open_key(shard_file(index >> (L-lognfiles)));
+	read_path(reader,fd,index,upk);
+	bool ok = reader.submit();
+	close(fd);
+	if(!ok){
+		cerr<<"calc_update_key: cannot read the update key of "<<index<<" from "<<shard_file(index >> (L-lognfiles))<<endl;
+		return vector<Ec1>();
+	}
 	
-    for(int j=L-1;j>=lognfiles;j--){
-		
-		
-		
-		int filenum = (index >> (L-j-1))*nfiles/(int)pow(2,j+1);
-		int keynum = (index >> (L-j-1))% ((int)pow(2,j+1)/nfiles);
-		
-		//cout<<index<<" "<<filenum<<" "<<keynum<<endl;
-		
-		
-		vector<vector<Ec1> > load_prk(L+1);
-		for(int k=lognfiles+1;k<L+1;k++)
-			load_prk[k].resize((int)pow(2,k-lognfiles));
-		
-		
-		ifstream InFile;
-		string filename = path+"pk"+to_string(filenum)+".txt";
-		InFile.open(filename, ios::in | ios::binary);
-		
-		
-		for(int k= lognfiles+1; k<L+1;k++){
-			for(int t=0;t<load_prk[k].size();t++){
-				InFile.read( (char*)&load_prk[k][t], sizeof(Ec1));
-			
-			}
-		}
-		
-		InFile.close();
+	if(cache!=NULL)
+		cache->put_upk(index,upk);
 	
-    	upk[j] = load_prk[j+1][keynum];
-    }
     return upk;
 }
 
+//only the shards that hold one of the indices are opened, and only the points on their paths are read.
+//the indices are bucketed by shard and the buckets split between the threads of readers; while a thread reads
+//one shard the kernel is already fetching the pages of its next one.
 vector<vector<Ec1> > vcs::calc_update_key_batch(vector<long long int> index, vector<vector<Ec1> >& prk){
+	LATENCY_SCOPE(OP_CALC_UPDATE_KEY_BATCH);
     vector<vector<Ec1> > upk;
     upk.resize(index.size());
 	for(int i=0;i<index.size();i++)
 		upk[i].resize(L);
+	mem_tracker upk_mem(MEM_LOAD_BUFFERS, index.size()*L*sizeof(Ec1));
 	
 	for(int i=0;i<upk.size();i++){
 		for(int j=lognfiles-1;j>=0;j--){
@@ -373,154 +863,448 @@ vector<vector<Ec1> > vcs::calc_update_key_batch(vector<long long int> index, vec
 		}
 	}
 	
+	if(L==lognfiles || index.empty())
+		return upk;
 	
-	for(int filenum = 0; filenum<nfiles; filenum++){
+	//(shard, position in index) of every index that is not a cached hot index, sorted so that every shard is one contiguous bucket
+	vector<pair<long long,int> > order;
+	for(int i=0;i<index.size();i++){
+		if(cache==NULL || !cache->get_upk(index[i],upk[i]))
+			order.push_back(make_pair(index[i] >> (L-lognfiles), i));
+	}
+	sort(order.begin(), order.end());
 	
+	vector<int> bucket;
+	for(int i=0;i<order.size();i++){
+		if(i==0 || order[i].first!=order[i-1].first)
+			bucket.push_back(i);
+	}
+	int nbuckets = bucket.size();
+	bucket.push_back(order.size());
+	
+	auto f = [](vcs* self, int x, int y, vector<int>* bucket, vector<pair<long long,int> >* order, vector<long long>* index, vector<vector<Ec1> >* upk) {
+		int fd = -1, next_fd = -1;
+		key_reader& reader = thread_reader();
 		
-		
-		vector<vector<Ec1> > load_prk(L+1);
-		for(int k=lognfiles+1;k<L+1;k++)
-			load_prk[k].resize((int)pow(2,k-lognfiles));
-		
-		ifstream InFile;
-		string filename = path+"pk"+to_string(filenum)+".txt";
-		InFile.open(filename, ios::in | ios::binary);
-		
-		
-		for(int k= lognfiles+1; k<L+1;k++){
-			for(int t=0;t<load_prk[k].size();t++){
-				InFile.read( (char*)&load_prk[k][t], sizeof(Ec1));
+		for(int b=x;b<y;b++){
+			if(b==x)
+				fd = open_key(self->shard_file((*order)[(*bucket)[b]].first));
+			else
+				fd = next_fd;
 			
+			if(b+1<y){
+				next_fd = open_key(self->shard_file((*order)[(*bucket)[b+1]].first));
+				for(int k=(*bucket)[b+1];k<(*bucket)[b+2];k++)
+					self->prefetch_path(next_fd, (*index)[(*order)[k].second]);
 			}
+			
+			//all reads of a bucket are in flight together
+			for(int k=(*bucket)[b];k<(*bucket)[b+1];k++){
+				int i = (*order)[k].second;
+				self->read_path(reader, fd, (*index)[i], (*upk)[i]);
+			}
+			bool ok = reader.submit();
+			if(!ok)
+				cerr<<"calc_update_key_batch: cannot read update keys from "<<self->shard_file((*order)[(*bucket)[b]].first)<<endl;
+			
+			for(int k=(*bucket)[b];k<(*bucket)[b+1];k++){
+				int i = (*order)[k].second;
+				if(!ok)
+					(*upk)[i].clear();
+				else if(self->cache!=NULL)
+					self->cache->put_upk((*index)[i], (*upk)[i]);
+			}
+			
+			close(fd);
 		}
-		
-		
-		InFile.close();
-		
-
+	};
+	
+	int nthreads = nbuckets<ncore ? nbuckets : ncore;
+	call_once(readers_started, [this]{ readers = new reader_pool(ncore); });
 	
-		for(int i=0;i<index.size();i++){
-			for(int j=L-1;j>=lognfiles;j--){
+	readers->run(nthreads, [&](int k){
+		f(this, (long long)nbuckets*k/nthreads, (long long)nbuckets*(k+1)/nthreads, &bucket, &order, &index, &upk);
+	});
 
-			
-				int filenum_temp = (index[i] >> (L-j-1))*nfiles/(int)pow(2,j+1);
-				int keynum = (index[i] >> (L-j-1))% ((int)pow(2,j+1)/nfiles);
-				
-				if(filenum_temp == filenum){
-					upk[i][j] = load_prk[j+1][keynum];
-				
-				}
-				
+    return upk;
+}
+
+
+//prk[level][nodes[i]] for every i, read from the shards below lognfiles. nodes should be sorted so that each shard is opened once.
+//empty if a point cannot be read
+vector<Ec1> vcs::get_prk_batch(int level, vector<long long>& nodes, vector<vector<Ec1> >& prk){
+	vector<Ec1> points(nodes.size());
+	mem_tracker points_mem(MEM_LOAD_BUFFERS, nodes.size()*sizeof(Ec1));
+	
+	if(level<=lognfiles){
+		for(int i=0;i<nodes.size();i++)
+			points[i] = prk[level][nodes[i]];
+		return points;
+	}
+	
+	key_reader& reader = thread_reader();
+	vector<int> fds;
+	long long filenum = -1, mask = ((long long)1<<(level-lognfiles))-1;
+	bool ok = true;
+	
+	for(int i=0;i<nodes.size();i++){
+		if((nodes[i] >> (level-lognfiles)) != filenum){
+			if(fds.size()==MAX_OPEN_SHARDS){
+				ok = reader.submit() && ok;
+				for(int k=0;k<fds.size();k++)
+					close(fds[k]);
+				fds.clear();
 			}
+			filenum = nodes[i] >> (level-lognfiles);
+			fds.push_back(open_key(shard_file(filenum)));
 		}
+		reader.read(fds.back(), shard_offset(level, nodes[i] & mask), &points[i], sizeof(Ec1));
+	}
 	
+	ok = reader.submit() && ok;
+	for(int k=0;k<fds.size();k++)
+		close(fds[k]);
+	if(!ok){
+		cerr<<"get_prk_batch: cannot read level "<<level<<" from the shards in "<<shard_path<<endl;
+		return vector<Ec1>();
 	}
-
-    return upk;
+	
+	return points;
 }
 
+//sum of coeffs[i]*prk[level][nodes[i]], coefficients may be negative. keys are fetched in chunks so memory stays bounded.
+//ok turns false if the keys cannot be read
+Ec1 vcs::commit_level(int level, vector<long long>& nodes, vector<mpz_class>& coeffs, vector<vector<Ec1> >& prk, bool& ok){
+	Ec1 result = g1*0;
+	
+	for(long long start=0;start<nodes.size();start+=COMMIT_CHUNK){
+		long long end = start+COMMIT_CHUNK<nodes.size() ? start+COMMIT_CHUNK : nodes.size();
+		vector<long long> chunk(nodes.begin()+start, nodes.begin()+end);
+		vector<Ec1> points = get_prk_batch(level, chunk, prk);
+		if(points.empty()){
+			ok = false;
+			return result;
+		}
+		
+		for(long long i=start;i<end;i++){
+			if(coeffs[i]==1)
+				result = ec1_add(result,points[i-start]);
+			else if(coeffs[i]!=0)
+				result = ec1_add(result,ec1_mul(points[i-start],coeffs[i]));
+		}
+	}
+	
+	return result;
+}
 
-Ec1 vcs::setup(vector<mpz_class>& a, vector<vector<Ec1> >& prk){
+Ec1 vcs::setup(vector<mpz_class>& a, vector<vector<Ec1> >& prk, bool* ok){
+	LATENCY_SCOPE(OP_SETUP);
 
-	Ec1 digest = g1*0;
-	for(int i=0;i<N;i++){
+	vector<long long> nodes;
+	vector<mpz_class> coeffs;
+	for(long long i=0;i<N;i++){
 		if(a[i]!=0){
-			if(a[i]==1){
-				digest = digest+ prk[L][i];
-			}
-			else{
-				if(a[i]>=0){
-					const mie::Vuint temp((a[i].get_str()).c_str());
-					digest = digest+prk[L][i]*temp;
-				}
-				else{
-					mpz_class temp2= -a[i];
-					const mie::Vuint temp((temp2.get_str()).c_str());
-					digest = digest-prk[L][i]*temp;
-				}
-			}
+			nodes.push_back(i);
+			coeffs.push_back(a[i]);
 		}
 	}
+	mem_tracker coeffs_mem(MEM_COEFFS, nodes.size()*(sizeof(long long)+MPZ_BYTES));
 	
+	bool read = true;
+	Ec1 digest = commit_level(L,nodes,coeffs,prk,read);
+	if(ok!=NULL)
+		*ok = read;
 	return digest;
 
 }
 
+Ec1 vcs::setup(sparse_vector& a, vector<vector<Ec1> >& prk, bool* ok){
+	LATENCY_SCOPE(OP_SETUP);
+
+	vector<long long> nodes;
+	vector<mpz_class> coeffs;
+	for(auto it=a.entries.begin();it!=a.entries.end();it++){
+		nodes.push_back(it->first);
+		coeffs.push_back(it->second);
+	}
+	mem_tracker coeffs_mem(MEM_COEFFS, nodes.size()*(sizeof(long long)+MPZ_BYTES));
+	
+	bool read = true;
+	Ec1 digest = commit_level(L,nodes,coeffs,prk,read);
+	if(ok!=NULL)
+		*ok = read;
+	return digest;
+
+}
 
-vector<Ec1> vcs::prove(int index, vector<mpz_class>& a, vector<vector<Ec1> >& prk){
+
+vector<Ec1> vcs::prove(long long index, vector<mpz_class>& a, vector<vector<Ec1> >& prk){
+	LATENCY_SCOPE(OP_PROVE);
 
 	vector<bool> index_binary = to_binary(index,L);
 	
 	vector<mpz_class> witness_coeffs(N), temp_coeffs = a;
+	mem_tracker coeffs_mem(MEM_COEFFS, 2*N*MPZ_BYTES);
 	
-	int start_index = 0;
+	long long start_index = 0;
 	
 	for(int i=0;i<L;i++){
-		for(int j=0;j<pow(2,L-i-1);j++){
+		long long half = (long long)1<<(L-i-1);
+		for(long long j=0;j<half;j++){
 			witness_coeffs[start_index+j] = (-temp_coeffs[2*j]+temp_coeffs[2*j+1])%p;
 			temp_coeffs[j] = (-temp_coeffs[2*j]*(index_binary[i]-1)+temp_coeffs[2*j+1]*index_binary[i])%p;
 		}
-		temp_coeffs.resize(pow(2,L-i-1));
-		start_index+=pow(2,L-i-1);
+		temp_coeffs.resize(half);
+		start_index+=half;
 	}
 	
 	
 	vector<Ec1> witness(L);
+	bool ok = true;
 	
 	start_index = 0;
 	
 	for(int i=0;i<L;i++){
-		witness[i] = g1*0;
+		long long half = (long long)1<<(L-i-1);
 		
-		for(int j=0;j<pow(2,L-i-1);j++){
-			if(witness_coeffs[start_index+j]>0){
-				const mie::Vuint temp((witness_coeffs[start_index+j].get_str()).c_str());
-				witness[i] += prk[L-i-1][j]*temp;	
-			}
-			else{
-				witness_coeffs[start_index+j]=-witness_coeffs[start_index+j];
-				const mie::Vuint temp((witness_coeffs[start_index+j].get_str()).c_str());
-				witness[i] -= prk[L-i-1][j]*temp;	
+		vector<long long> nodes;
+		vector<mpz_class> coeffs;
+		for(long long j=0;j<half;j++){
+			if(witness_coeffs[start_index+j]!=0){
+				nodes.push_back(j);
+				coeffs.push_back(witness_coeffs[start_index+j]);
 			}
 		}
 		
-		start_index+=pow(2,L-i-1);
+		witness[i] = commit_level(L-i-1,nodes,coeffs,prk,ok);
+		if(!ok)
+			return vector<Ec1>();
+		
+		start_index+=half;
+		
+	}
+	
+	return witness;
+
+}
+
+//same folding as the dense prove, but only over the non-zero entries: pairs (2j, 2j+1) give the witness coefficient of node j
+//and fold into entry j of the next level
+vector<Ec1> vcs::prove(long long index, sparse_vector& a, vector<vector<Ec1> >& prk){
+	LATENCY_SCOPE(OP_PROVE);
+	
+	vector<pair<long long, mpz_class> > cur(a.entries.begin(), a.entries.end()), next;
+	vector<Ec1> witness(L);
+	bool ok = true;
+	
+	for(int i=0;i<L;i++){
+		int bit = (index>>i)&1;
+		
+		vector<long long> nodes;
+		vector<mpz_class> coeffs;
+		next.clear();
+		
+		for(long long k=0;k<cur.size();){
+			long long j = cur[k].first>>1;
+			mpz_class even = 0, odd = 0;
+			for(;k<cur.size() && (cur[k].first>>1)==j;k++){
+				if(cur[k].first&1)
+					odd = cur[k].second;
+				else
+					even = cur[k].second;
+			}
+			
+			mpz_class w = (odd-even)%p;
+			if(w!=0){
+				nodes.push_back(j);
+				coeffs.push_back(w);
+			}
+			
+			mpz_class &v = bit ? odd : even;
+			if(v!=0)
+				next.push_back(make_pair(j,v));
+		}
 		
+		witness[i] = commit_level(L-i-1,nodes,coeffs,prk,ok);
+		if(!ok)
+			return vector<Ec1>();
+		cur.swap(next);
 	}
 	
 	return witness;
+}
 
+multi_proof vcs::prove_multi(vector<long long> index, vector<mpz_class>& a, vector<vector<Ec1> >& prk){
+	LATENCY_SCOPE(OP_PROVE_MULTI);
+	vector<pair<long long, mpz_class> > entries;
+	for(long long i=0;i<N;i++){
+		if(a[i]!=0)
+			entries.push_back(make_pair(i,a[i]));
+	}
+	return prove_multi_entries(index,entries,prk);
 }
 
-bool vcs::verify(Ec1 digest, int index, mpz_class a_i, vector<Ec1> proof, vector<Ec2> vrk){
+multi_proof vcs::prove_multi(vector<long long> index, sparse_vector& a, vector<vector<Ec1> >& prk){
+	LATENCY_SCOPE(OP_PROVE_MULTI);
+	vector<pair<long long, mpz_class> > entries(a.entries.begin(), a.entries.end());
+	return prove_multi_entries(index,entries,prk);
+}
+
+//the sparse fold of prove, run once per distinct value of the low i bits of the indices at level i: every such
+//prefix gives one witness and folds into the prefixes of level i+1 that some index continues with
+multi_proof vcs::prove_multi_entries(vector<long long>& index, vector<pair<long long, mpz_class> >& entries, vector<vector<Ec1> >& prk){
+	multi_proof proof;
+	proof.index = index;
+	sort(proof.index.begin(),proof.index.end());
+	proof.index.erase(unique(proof.index.begin(),proof.index.end()),proof.index.end());
+	
+	map<long long, vector<pair<long long, mpz_class> > > cur, next;
+	cur[0] = entries;
+	bool ok = true;
 	
+	for(int i=0;i<L;i++){
+		long long child_mask = ((long long)2<<i)-1;
+		set<long long> children;
+		for(long long k=0;k<proof.index.size();k++)
+			children.insert(proof.index[k]&child_mask);
+		
+		next.clear();
+		for(auto it=cur.begin();it!=cur.end();it++){
+			long long prefix = it->first;
+			vector<pair<long long, mpz_class> >& v = it->second;
+			bool need[2];
+			vector<pair<long long, mpz_class> > fold[2];
+			for(int b=0;b<2;b++)
+				need[b] = children.count(prefix|((long long)b<<i))>0;
+			
+			vector<long long> nodes;
+			vector<mpz_class> coeffs;
+			for(long long k=0;k<v.size();){
+				long long j = v[k].first>>1;
+				mpz_class even = 0, odd = 0;
+				for(;k<v.size() && (v[k].first>>1)==j;k++){
+					if(v[k].first&1)
+						odd = v[k].second;
+					else
+						even = v[k].second;
+				}
+				
+				mpz_class w = (odd-even)%p;
+				if(w!=0){
+					nodes.push_back(j);
+					coeffs.push_back(w);
+				}
+				
+				if(need[0] && even!=0)
+					fold[0].push_back(make_pair(j,even));
+				if(need[1] && odd!=0)
+					fold[1].push_back(make_pair(j,odd));
+			}
+			
+			proof.witness[make_pair(i,prefix)] = commit_level(L-i-1,nodes,coeffs,prk,ok);
+			if(!ok)
+				return multi_proof();
+			for(int b=0;b<2;b++){
+				if(need[b])
+					next[prefix|((long long)b<<i)].swap(fold[b]);
+			}
+		}
+		cur.swap(next);
+	}
 	
+	return proof;
+}
+
+//every index k checks e(C - a_k*g1, g2) == prod_i e(vrk[L-i-1] - b_ki*g2, proof_k[i]). with random r_k the checks
+//combine into e(sum r_k*(C - a_k*g1) + sum_ki r_k*b_ki*proof_k[i], g2) == prod_i e(vrk[L-i-1], sum_k r_k*proof_k[i]),
+//where the sums over k collapse onto the shared witnesses
+bool vcs::verify_multi(Ec1 digest, multi_proof& proof, vector<mpz_class> a_i, vector<Ec2> vrk){
+	LATENCY_SCOPE(OP_VERIFY_MULTI);
+	long long k = proof.index.size();
+	if(a_i.size()!=k)
+		return false;
+	
+	//the witnesses must be exactly the ones the indices use
+	set<pair<int,long long> > used;
+	for(long long m=0;m<k;m++){
+		for(int i=0;i<L;i++)
+			used.insert(make_pair(i,proof.index[m]&(((long long)1<<i)-1)));
+	}
+	if(used.size()!=proof.witness.size())
+		return false;
+	for(auto it=used.begin();it!=used.end();it++){
+		if(proof.witness.count(*it)==0)
+			return false;
+	}
+	
+	//random seed
+	unsigned long int seed;
+	gmp_randstate_t r_state;
+	ifstream urandom("/dev/urandom", ios::in|ios::binary);
+	urandom.read((char*)&seed,sizeof(seed));
+	urandom.close();
+	gmp_randinit_default(r_state);
+	gmp_randseed_ui(r_state, seed);
+	
+	//coefficients of every witness from the indices with bit 0 and bit 1 at its level
+	map<pair<int,long long>, pair<mpz_class,mpz_class> > c;
+	mpz_class a=0, r_sum=0, r;
+	for(long long m=0;m<k;m++){
+		mpz_urandomb(r.get_mpz_t(),r_state,128);
+		a+=a_i[m]*r;
+		r_sum+=r;
+		for(int i=0;i<L;i++){
+			pair<mpz_class,mpz_class>& cw = c[make_pair(i,proof.index[m]&(((long long)1<<i)-1))];
+			if((proof.index[m]>>i)&1)
+				cw.second+=r;
+			else
+				cw.first+=r;
+		}
+	}
+	gmp_randclear(r_state);
+	
+	vector<Ec1> level(L, g1*0);
+	Ec1 left = ec1_sub(ec1_mul(digest,r_sum),ec1_mul(g1,a));
+	for(auto it=c.begin();it!=c.end();it++){
+		int i = it->first.first;
+		Ec1& w = proof.witness[it->first];
+		if(it->second.first!=0)
+			level[i] = ec1_add(level[i],ec1_mul(w,it->second.first));
+		if(it->second.second!=0){
+			Ec1 temp = ec1_mul(w,it->second.second);
+			level[i] = ec1_add(level[i],temp);
+			left = ec1_add(left,temp);
+		}
+	}
+	
+	Fp12 e1,e2,e3=1;
+	pairing(e1,g2,left);
+	for(int i=0;i<L;i++){
+		pairing(e2,vrk[L-i-1],level[i]);
+		e3*=e2;
+	}
+	
+	return (e1==e3);
+}
+
+bool vcs::verify(Ec1 digest, long long index, mpz_class a_i, vector<Ec1> proof, vector<Ec2> vrk){
+	LATENCY_SCOPE(OP_VERIFY);
+	
+	//prove returns an empty proof when it could not read the keys
+	if(proof.size()!=L)
+		return false;
 	
 	Fp12 e1,e3=1;
 	vector<Fp12> e2(L);
 	vector<bool> index_binary=to_binary(index,L);
 	
-	if(a_i>=0){
-		const mie::Vuint temp2((a_i.get_str()).c_str());
-		Ec1 temp = g1*temp2;
-		opt_atePairing(e1,g2, digest-temp);
-	}
-	else{
-		a_i=-a_i;
-		const mie::Vuint temp2((a_i.get_str()).c_str());
-		Ec1 temp = g1*temp2;
-		opt_atePairing(e1,g2, digest+temp);
-	}
+	pairing(e1,g2, ec1_sub(digest,ec1_mul(g1,a_i)));
 	
 	for(int i=0;i<L;i++){
 		Ec2 temp1 = vrk[L-i-1]-g2*(int)index_binary[i];
 		
 		
-		//clock_t t1=clock();
-		opt_atePairing(e2[i],temp1, proof[i]);
-		//if(i==0){
-			//cout<<"pairing time: "<<(double)(clock()-t1)/CLOCKS_PER_SEC<<"s\n";
-		//}
+		pairing(e2[i],temp1, proof[i]);
 		
 		e3*=e2[i];
 		
@@ -552,9 +1336,16 @@ bool vcs::verify(Ec1 digest, int index, mpz_class a_i, vector<Ec1> proof, vector
 	
 }
 
-bool vcs::batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vector<vector<Ec1> > proof, vector<Ec2> vrk){
-	
-	clock_t t1=clock();
+bool vcs::batch_verify(Ec1 digest, vector<long long> index, vector<mpz_class> a_i, vector<vector<Ec1> > proof, vector<Ec2> vrk){
+	LATENCY_SCOPE(OP_BATCH_VERIFY);
+	TRACE_SPAN_ARG("batch_verify", index.size());
+	
+	if(a_i.size()!=index.size() || proof.size()!=index.size())
+		return false;
+	for(int i=0;i<proof.size();i++){
+		if(proof[i].size()!=L)
+			return false;
+	}
 	
 	// to binary
 	vector<vector<bool> > index_binary(index.size());
@@ -585,13 +1376,13 @@ bool vcs::batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vec
 	
 	//proof^randomness
 	
-	auto t2 = chrono::high_resolution_clock::now();
+	TRACE_SPAN_BEGIN(randomize, "batch_verify.randomize");
 	
 	auto f = [](int x, int y, vector<vector<Ec1> >* proof, vector<mpz_class>* r, int L) {
+		TRACE_SPAN_ARG("batch_verify.randomize_worker", y-x);
         for(int i=x;i<y;i++){
-			const mie::Vuint temp(((*r)[i].get_str()).c_str());
 			for(int j=0;j<L;j++){
-				(*proof)[i][j] = (*proof)[i][j]*temp;
+				(*proof)[i][j] = ec1_mul((*proof)[i][j],(*r)[i]);
 			}
 		}
     };
@@ -599,7 +1390,7 @@ bool vcs::batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vec
 	thread th[ncore];
 	
 	for(int k=0;k<ncore;k++)
-		th[k]=thread(f,index.size()/ncore*k, index.size()/ncore*(k+1),&proof, &r, L);
+		th[k]=thread(f,index.size()/ncore*k, k==ncore-1 ? index.size() : index.size()/ncore*(k+1),&proof, &r, L);
 		
 	/*
 	
@@ -630,9 +1421,7 @@ bool vcs::batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vec
 	for(int k=0;k<ncore;k++)
 		th[k].join();	
 	
-	auto t3 = chrono::high_resolution_clock::now();
-	auto t4 = t3 - t2;
-	//cout << "verify time: " << chrono::duration<double, milli>(t4).count()/1000 << "s" << endl;
+	TRACE_SPAN_END(randomize);
 	
 	/*
 	for(int i=0;i<index.size();i++){
@@ -663,31 +1452,30 @@ bool vcs::batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vec
 		r_sum+=p;
 	
 	
-	const mie::Vuint temp2((a.get_str()).c_str());
-	const mie::Vuint temp3((r_sum.get_str()).c_str());
-	opt_atePairing(e1,g2, digest*temp3-g1*temp2);
+	pairing(e1,g2, ec1_sub(ec1_mul(digest,r_sum),ec1_mul(g1,a)));
 	
 	
 	//right side
-	vector<Ec1> proof_combined(2*L, g1*0);
+	//the L additions of one proof go to distinct buckets, so they run as one batch
+	TRACE_SPAN_BEGIN(combine, "batch_verify.combine");
+	vector<Ec1> proof_combined(2*L, g1*0), acc(L);
 	for(int i=0;i<index.size();i++){
-		for(int j=0;j<L;j++){
-			if(index_binary[i][j]==0){
-				proof_combined[2*j]=proof_combined[2*j]+proof[i][j];
-			}
-			else
-				proof_combined[2*j+1]=proof_combined[2*j+1]+proof[i][j];
-		}
+		for(int j=0;j<L;j++)
+			acc[j]=proof_combined[2*j+index_binary[i][j]];
+		ec1_add_batch(acc.data(),acc.data(),proof[i].data(),L);
+		for(int j=0;j<L;j++)
+			proof_combined[2*j+index_binary[i][j]]=acc[j];
 	}
+	TRACE_SPAN_END(combine);
 	
 	for(int i=0;i<L;i++){
 		Ec2 temp1 = vrk[L-i-1]-g2*0;
-		opt_atePairing(e2,temp1, proof_combined[2*i]);
+		pairing(e2,temp1, proof_combined[2*i]);
 		
 		e3*=e2;
 		
 		temp1 = vrk[L-i-1]-g2*1;
-		opt_atePairing(e2,temp1, proof_combined[2*i+1]);
+		pairing(e2,temp1, proof_combined[2*i+1]);
 		
 		e3*=e2;
 		
@@ -698,89 +1486,153 @@ bool vcs::batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vec
 	
 }
 
-Ec1 vcs::update_digest(Ec1 digest, int updateindex, mpz_class delta, vector<Ec1> upk_u){
-	if(delta>=0){
-		const mie::Vuint temp((delta.get_str()).c_str());
-		return digest+upk_u[L-1]*temp;
-	}
-	else{
-		delta=-delta;
-		const mie::Vuint temp((delta.get_str()).c_str());
-		return digest-upk_u[L-1]*temp;
-	}
-
+Ec1 vcs::update_digest(Ec1 digest, long long updateindex, mpz_class delta, vector<Ec1> upk_u){
+	LATENCY_SCOPE(OP_UPDATE_DIGEST);
+	return ec1_add(digest,ec1_mul(upk_u[L-1],delta));
 }
 
-vector<Ec1> vcs::update_proof(vector<Ec1> proof, int updateindex, int index, mpz_class delta, vector<Ec1> upk_u){
+vector<Ec1> vcs::update_proof(vector<Ec1> proof, long long updateindex, long long index, mpz_class delta, vector<Ec1> upk_u){
+	LATENCY_SCOPE(OP_UPDATE_PROOF);
 	vector<Ec1> new_proof=proof;
 	vector<bool> index_binary=to_binary(index,L), updateindex_binary=to_binary(updateindex,L);
 	
-	if(delta>=0){
-		const mie::Vuint temp((delta.get_str()).c_str());
-		for(int i=0;i<L;i++){
+	//level i moves by -+delta*upk_u[L-i-2] (g1 at the last level) for updateindex bit 0/1, up to the first bit
+	//where updateindex and index differ
+	for(int i=0;i<L;i++){
+		Ec1 temp = ec1_mul(i<L-1 ? upk_u[L-i-2] : g1, delta);
 		
-			if(i<L-1){
-				if(updateindex_binary[i] == 0 && index_binary[i]==1){
-					new_proof[i]=proof[i]-upk_u[L-i-2]*temp;
-					break;
-				}
-				else if(updateindex_binary[i] == 1 && index_binary[i]==0){
-					new_proof[i]=proof[i]+upk_u[L-i-2]*temp;
-					break;
-				}
-				else if(updateindex_binary[i] == 0 && index_binary[i]==0){
-					new_proof[i]=proof[i]-upk_u[L-i-2]*temp;
-				}
-				else{
-					new_proof[i]=proof[i]+upk_u[L-i-2]*temp;
-				}
-			}
-			else{
-				if(updateindex_binary[i] == 0 && index_binary[i]==1)
-					new_proof[i]=proof[i]-g1*temp;
-				else if(updateindex_binary[i] == 1 && index_binary[i]==0)
-					new_proof[i]=proof[i]+g1*temp;
-				else if(updateindex_binary[i] == 0 && index_binary[i]==0)
-					new_proof[i]=proof[i]-g1*temp;
-				else
-					new_proof[i]=proof[i]+g1*temp;
+		if(updateindex_binary[i] == 0)
+			new_proof[i]=ec1_sub(proof[i],temp);
+		else
+			new_proof[i]=ec1_add(proof[i],temp);
+		
+		if(updateindex_binary[i] != index_binary[i])
+			break;
+	}
+	
+	return new_proof;
+}
+
+//out[k] is the sum of terms[k], zero if it is empty. every round adds adjacent pairs of all lists in one
+//ec1_add_batch call, so the lists shrink by half together
+static void sum_batch(vector<vector<Ec1> >& terms, vector<Ec1>& out, const Ec1& zero){
+	vector<Ec1> a, b;
+	for(;;){
+		a.clear();
+		b.clear();
+		for(size_t k=0;k<terms.size();k++){
+			for(size_t j=0;j+1<terms[k].size();j+=2){
+				a.push_back(terms[k][j]);
+				b.push_back(terms[k][j+1]);
 			}
+		}
+		if(a.empty())
+			break;
+		ec1_add_batch(a.data(),a.data(),b.data(),a.size());
 		
+		size_t t=0;
+		for(size_t k=0;k<terms.size();k++){
+			size_t n=terms[k].size();
+			for(size_t j=0;j+1<n;j+=2)
+				terms[k][j/2]=a[t++];
+			if(n%2)
+				terms[k][n/2]=terms[k][n-1];
+			terms[k].resize((n+1)/2);
 		}
 	}
-	else{
-		delta=-delta;
-		const mie::Vuint temp((delta.get_str()).c_str());
-		for(int i=0;i<L;i++){
-		
-			if(i<L-1){
-				if(updateindex_binary[i] == 0 && index_binary[i]==1){
-					new_proof[i]=proof[i]+upk_u[L-i-2]*temp;
-					break;
-				}
-				else if(updateindex_binary[i] == 1 && index_binary[i]==0){
-					new_proof[i]=proof[i]-upk_u[L-i-2]*temp;
-					break;
-				}
-				else if(updateindex_binary[i] == 0 && index_binary[i]==0){
-					new_proof[i]=proof[i]+upk_u[L-i-2]*temp;
-				}
-				else{
-					new_proof[i]=proof[i]-upk_u[L-i-2]*temp;
-				}
-			}
-			else{
-				if(updateindex_binary[i] == 0 && index_binary[i]==1)
-					new_proof[i]=proof[i]+g1*temp;
-				else if(updateindex_binary[i] == 1 && index_binary[i]==0)
-					new_proof[i]=proof[i]-g1*temp;
-				else if(updateindex_binary[i] == 0 && index_binary[i]==0)
-					new_proof[i]=proof[i]+g1*temp;
+	
+	out.resize(terms.size());
+	for(size_t k=0;k<terms.size();k++)
+		out[k] = terms[k].empty() ? zero : terms[k][0];
+}
+
+Ec1 vcs::update_digest_batch(Ec1 digest, vector<long long>& updateindex, vector<mpz_class>& delta, vector<vector<Ec1> >& upk_u){
+	LATENCY_SCOPE(OP_UPDATE_DIGEST_BATCH);
+	vector<vector<Ec1> > terms(1);
+	terms[0].push_back(digest);
+	for(size_t u=0;u<updateindex.size();u++)
+		terms[0].push_back(ec1_mul(upk_u[u][L-1],delta[u]));
+	
+	vector<Ec1> sum;
+	sum_batch(terms,sum,g1*0);
+	return sum[0];
+}
+
+//last level of a proof of index that an update of updateindex moves, see update_proof
+static inline int update_reach(long long updateindex, long long index, int L){
+	long long x = updateindex^index;
+	return x==0 ? L-1 : min(__builtin_ctzll(x),L-1);
+}
+
+void vcs::update_proofs_batch(vector<vector<Ec1> >& proofs, vector<long long>& index, vector<long long>& updateindex, vector<mpz_class>& delta, vector<vector<Ec1> >& upk_u){
+	LATENCY_SCOPE(OP_UPDATE_PROOFS_BATCH);
+	size_t U=updateindex.size(), K=proofs.size();
+	
+	//delta*upk_u[L-i-2] moves level i of every proof that the update reaches, so it is computed once per update and level
+	vector<vector<Ec1> > prod(U);
+	for(size_t u=0;u<U;u++){
+		int reach=-1;
+		for(size_t k=0;k<K;k++)
+			reach=max(reach,update_reach(updateindex[u],index[k],L));
+		for(int i=0;i<=min(reach,L-2);i++)
+			prod[u].push_back(ec1_mul(upk_u[u][L-i-2],delta[u]));
+	}
+	
+	//the last level multiplies g1, so its deltas are summed as integers first
+	vector<vector<Ec1> > terms(K*L);
+	for(size_t k=0;k<K;k++){
+		mpz_class last=0;
+		for(int i=0;i<L;i++)
+			terms[k*L+i].push_back(proofs[k][i]);
+		for(size_t u=0;u<U;u++){
+			int reach=update_reach(updateindex[u],index[k],L);
+			for(int i=0;i<=reach;i++){
+				bool up=(updateindex[u]>>i)&1;
+				if(i==L-1)
+					last += up ? delta[u] : -delta[u];
 				else
-					new_proof[i]=proof[i]-g1*temp;
+					terms[k*L+i].push_back(up ? prod[u][i] : -prod[u][i]);
 			}
-		
 		}
+		if(last!=0)
+			terms[k*L+L-1].push_back(ec1_mul(g1,last));
+	}
+	
+	vector<Ec1> sum;
+	sum_batch(terms,sum,g1*0);
+	for(size_t k=0;k<K;k++){
+		for(int i=0;i<L;i++)
+			proofs[k][i]=sum[k*L+i];
+	}
+}
+
+vector<ec1_table> vcs::upk_tables(vector<Ec1>& upk_u){
+	vector<ec1_table> upk_t(L);
+	for(int i=0;i<L;i++)
+		ec1_table_init(upk_t[i],upk_u[i]);
+	return upk_t;
+}
+
+Ec1 vcs::update_digest(Ec1 digest, long long updateindex, long long delta, vector<ec1_table>& upk_t){
+	LATENCY_SCOPE(OP_UPDATE_DIGEST);
+	return ec1_add(digest,ec1_mul_si(upk_t[L-1],delta));
+}
+
+vector<Ec1> vcs::update_proof(vector<Ec1> proof, long long updateindex, long long index, long long delta, vector<ec1_table>& upk_t){
+	LATENCY_SCOPE(OP_UPDATE_PROOF);
+	vector<Ec1> new_proof=proof;
+	
+	//same walk as the mpz_class version
+	for(int i=0;i<L;i++){
+		Ec1 temp = ec1_mul_si(i<L-1 ? upk_t[L-i-2] : g1_table, delta);
+		
+		if(((updateindex>>i)&1) == 0)
+			new_proof[i]=ec1_sub(proof[i],temp);
+		else
+			new_proof[i]=ec1_add(proof[i],temp);
+		
+		if(((updateindex>>i)&1) != ((index>>i)&1))
+			break;
 	}
 	
 	return new_proof;
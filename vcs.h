@@ -1,44 +1,132 @@
+#ifndef VCS_H
+#define VCS_H
+
 #include <vector>
+#include <map>
 #include "test_point.hpp"
 #include "bn.h"
 #include <gmp.h>
 #include <gmpxx.h>
 #include <fstream>
 #include <thread>
+#include <mutex>
+#include "fr.h"
+#include "upk_cache.h"
+#include "key_io.h"
+#include "sparse.h"
+#include "glv.h"
+#include "latency.h"
 
 using namespace std;
 using namespace bn;
 
 
+#define LAYOUT_LEVEL 0 //each shard stores its levels one after another
+#define LAYOUT_BLOCKED 1 //each shard stores subtrees of height block_height together, see shard_offset
+#define PAGE_BYTES 4096
+
+//opening of a set of indices. proof[i] of an index only depends on its bits 0..i-1, so indices sharing low bits
+//share witnesses: witness[(i, index & ((1<<i)-1))] is proof[i] of every index with those low bits.
+struct multi_proof{
+	vector<long long> index; //sorted, no duplicates
+	map<pair<int,long long>,Ec1> witness;
+};
+
 class vcs{
 	public:
 	vcs(int, mpz_class, Ec1, Ec2);
 	~vcs();
+	//owns cache
+	vcs(const vcs&) = delete;
+	vcs& operator=(const vcs&) = delete;
 	
 	
 	mpz_class p; //p is the prime that defines the field, and it must be the same as the base group of the bilinear group.
 	
-	int L,N,P;
+	int L,P;
+	long long N;
 
 	Ec1 g1;
 	Ec2 g2;
+	ec1_table g1_table;
 	
 	//L is the number of variables and N=2^L is the number of elements in the vector.
 	//P is the number of bits in p. It is used for fast exponentiation during keygen
 	
+	int lognfiles, nfiles, layout, block_height;
+	string path, shard_path;
+	
+	//levels 0..lognfiles of prk are kept in path/pk.txt, the subtree below prk[lognfiles][i] in shard_path/pk<i>.txt.
+	//the key set is described by path/header.txt, written by keygen and read by load_key.
+	//set_layout keeps the current layout and returns false unless 0<=lognfiles<=L, layout is LAYOUT_LEVEL or
+	//LAYOUT_BLOCKED and block_height>=1
+	bool set_layout(int lognfiles, string shard_path = "", int layout = LAYOUT_LEVEL, int block_height = 4);
+	bool save_header();
+	bool load_header();
+	long long shard_offset(int level, long long keynum);
+	long long shard_size();
+	long long shard_run(int level);
+	long long block_stride(int height);
+	string shard_file(long long filenum);
+	void read_path(key_reader& reader, int fd, long long index, vector<Ec1>& upk);
+	void prefetch_path(int fd, long long index);
+	//drops pk.txt, vrk.txt and the shards from the page cache, so the next reads go to the device
+	void evict_keys();
+	
+	upk_cache* cache; //NULL unless enable_cache was called. keygen, keygen_root and load_key empty it
+	void enable_cache(size_t node_entries, size_t upk_entries, int prefix_levels);
+	void disable_cache();
+	
+	//the threads of calc_update_key_batch, started by its first call and kept until the vcs is destroyed
+	reader_pool* readers;
+	once_flag readers_started;
+	
 
+	//an update key that cannot be read from its shard comes back empty
 	vector<Ec1> calc_update_key(long long int index, vector<vector<Ec1> >& prk);
 	vector<vector<Ec1> > calc_update_key_batch(vector<long long int> index, vector<vector<Ec1> >& prk);
 
-	void keygen(vector<vector<Ec1> >& prk, vector<Ec2>& vrk);
-	void load_key(vector<vector<Ec1> >& prk, vector<Ec2>& vrk);
+	bool keygen(vector<vector<Ec1> >& prk, vector<Ec2>& vrk); //false if a shard or keygen.state cannot be written, or the state is for another layout
+	bool keygen_root(vector<vector<Ec1> >& prk, vector<Ec2>& vrk);
+	bool keygen_worker(int worker, int nworkers);
+	bool keygen_merge(int nworkers);
+	void keygen_top(vector<fr_t>& s, vector<Ec1>& g1_pre, vector<vector<Ec1> >& prk, vector<fr_t>& vars);
+	bool keygen_shard(int batch, vector<fr_t>& s, vector<Ec1>& g1_pre, fr_t root_var, Ec1 root_prk);
+	void sample_secrets(vector<fr_t>& s);
+	bool save_key(vector<fr_t>& s, vector<vector<Ec1> >& prk, vector<Ec2>& vrk);
+	bool load_keygen_state(vector<fr_t>& s);
+	bool save_keygen_state(vector<fr_t>& s);
+	void read_manifest(string filename, vector<bool>& done);
+	bool load_key(vector<vector<Ec1> >& prk, vector<Ec2>& vrk); //false if header.txt is missing, for another L or an invalid layout, or a key file cannot be read
+	
+	vector<Ec1> get_prk_batch(int level, vector<long long>& nodes, vector<vector<Ec1> >& prk);
+	multi_proof prove_multi_entries(vector<long long>& index, vector<pair<long long, mpz_class> >& entries, vector<vector<Ec1> >& prk);
+	Ec1 commit_level(int level, vector<long long>& nodes, vector<mpz_class>& coeffs, vector<vector<Ec1> >& prk, bool& ok);
 	
-	Ec1 setup(vector<mpz_class>& a, vector<vector<Ec1> >& prk);
+	//ok, if given, turns false when the keys cannot be read; prove and prove_multi then return an empty proof
+	Ec1 setup(vector<mpz_class>& a, vector<vector<Ec1> >& prk, bool* ok = NULL);
+	Ec1 setup(sparse_vector& a, vector<vector<Ec1> >& prk, bool* ok = NULL);
 
-	vector<Ec1> prove(int index, vector<mpz_class>& a, vector<vector<Ec1> >& prk);
-	bool verify(Ec1 digest, int index, mpz_class a_i, vector<Ec1> proof, vector<Ec2> vrk);
-	bool batch_verify(Ec1 digest, vector<int> index, vector<mpz_class> a_i, vector<vector<Ec1> > proof, vector<Ec2> vrk);
-	Ec1 update_digest(Ec1 digest, int updateindex, mpz_class delta, vector<Ec1> upk_u);
-	vector<Ec1> update_proof(vector<Ec1> proof, int updateindex, int index, mpz_class delta, vector<Ec1> upk_u);
+	vector<Ec1> prove(long long index, vector<mpz_class>& a, vector<vector<Ec1> >& prk);
+	vector<Ec1> prove(long long index, sparse_vector& a, vector<vector<Ec1> >& prk);
+	bool verify(Ec1 digest, long long index, mpz_class a_i, vector<Ec1> proof, vector<Ec2> vrk);
+	bool batch_verify(Ec1 digest, vector<long long> index, vector<mpz_class> a_i, vector<vector<Ec1> > proof, vector<Ec2> vrk);
+	
+	//a_i[k] is the value at proof.index[k]. verify_multi needs L+1 pairings for any number of indices
+	multi_proof prove_multi(vector<long long> index, vector<mpz_class>& a, vector<vector<Ec1> >& prk);
+	multi_proof prove_multi(vector<long long> index, sparse_vector& a, vector<vector<Ec1> >& prk);
+	bool verify_multi(Ec1 digest, multi_proof& proof, vector<mpz_class> a_i, vector<Ec2> vrk);
+	Ec1 update_digest(Ec1 digest, long long updateindex, mpz_class delta, vector<Ec1> upk_u);
+	vector<Ec1> update_proof(vector<Ec1> proof, long long updateindex, long long index, mpz_class delta, vector<Ec1> upk_u);
+	//a block of updates applied at once: every product delta*upk is computed once and shared by all proofs,
+	//and the sums go through ec1_add_batch. proofs[k] is the proof of index[k]
+	Ec1 update_digest_batch(Ec1 digest, vector<long long>& updateindex, vector<mpz_class>& delta, vector<vector<Ec1> >& upk_u);
+	void update_proofs_batch(vector<vector<Ec1> >& proofs, vector<long long>& index, vector<long long>& updateindex, vector<mpz_class>& delta, vector<vector<Ec1> >& upk_u);
+	
+	//64-bit deltas with precomputed tables of an update key, for an update applied to the digest and many proofs
+	vector<ec1_table> upk_tables(vector<Ec1>& upk_u);
+	Ec1 update_digest(Ec1 digest, long long updateindex, long long delta, vector<ec1_table>& upk_t);
+	vector<Ec1> update_proof(vector<Ec1> proof, long long updateindex, long long index, long long delta, vector<ec1_table>& upk_t);
 };
 
+#endif
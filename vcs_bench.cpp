@@ -0,0 +1,280 @@
+#include "vcs.h"
+#include "bench.h"
+#include "glv.h"
+#include "ec1_batch.h"
+#include "key_io.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <random>
+#include <map>
+#include <sys/stat.h>
+
+#include "test_point.hpp"
+#include "bn.h"
+
+using namespace std;
+using namespace bn;
+
+//./vcs_bench [--filter=name] [--L=10,14] [--batch=1,16,256] [--min_time=0.5] [--max_iters=1000] [--json=out.json]
+//keys of every L are generated once under vcs_bench_keys/L<L>/ and shared by all cases of that L.
+
+#define BENCH_DIR "vcs_bench_keys/"
+#define PROOF_POOL 16 //indices with a ready proof, for verify and update_proof
+
+static mpz_class p;
+static Ec1 g1;
+static Ec2 g2;
+
+struct bench_env{
+	vcs* a;
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	vector<mpz_class> vals;
+	Ec1 digest;
+	vector<long long> index;
+	vector<vector<Ec1> > proofs;
+	mt19937_64 gen;
+};
+
+static vcs* make_vcs(int L, string dir){
+	vcs* a = new vcs(L,p,g1,g2);
+	mkdir(BENCH_DIR,S_IRWXU);
+	mkdir(dir.c_str(),S_IRWXU);
+	a->path = dir;
+	a->set_layout(L<3 ? L : 3,dir);
+	return a;
+}
+
+static bench_env& env(int L){
+	static map<int, bench_env*> envs;
+	if(envs.count(L))
+		return *envs[L];
+
+	bench_env* e = new bench_env;
+	e->a = make_vcs(L, BENCH_DIR "L"+to_string(L)+"/");
+	if(!e->a->keygen(e->prk,e->vrk) || !e->a->load_key(e->prk,e->vrk)){
+		cerr<<"keygen or load_key failed for L="<<L<<endl;
+		exit(1);
+	}
+	e->gen.seed(L);
+
+	uniform_int_distribution<int> vdistrib(0, numeric_limits<int>::max());
+	e->vals.resize(e->a->N);
+	for(long long i=0;i<e->a->N;i++)
+		e->vals[i] = vdistrib(e->gen);
+	e->digest = e->a->setup(e->vals,e->prk);
+
+	for(int j=0;j<PROOF_POOL;j++){
+		e->index.push_back(e->gen() % e->a->N);
+		e->proofs.push_back(e->a->prove(e->index.back(),e->vals,e->prk));
+	}
+
+	envs[L] = e;
+	return *e;
+}
+
+static long long random_index(bench_env& e){
+	return e.gen() % e.a->N;
+}
+
+static void keygen(bench_state& st){
+	vcs* a = make_vcs(st.L, BENCH_DIR "keygen_L"+to_string(st.L)+"/");
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	while(st.keep_running())
+		a->keygen(prk,vrk);
+	delete a;
+}
+BENCH_CASE(keygen);
+
+//the key files stay in the page cache (warm), are evicted before every iteration (cold) or are read with
+//O_DIRECT (direct). read_bytes is what the process fetched from storage per iteration.
+enum cache_mode{CACHE_WARM, CACHE_COLD, CACHE_DIRECT};
+
+static void io_case(bench_state& st, int mode, void (*op)(bench_env&, bench_state&)){
+	bench_env& e = env(st.L);
+	set_direct_io(mode==CACHE_DIRECT);
+	long long r0 = process_read_bytes();
+	while(st.keep_running()){
+		if(mode==CACHE_COLD){
+			st.pause();
+			e.a->evict_keys();
+			st.resume();
+		}
+		op(e,st);
+	}
+	if(r0>=0)
+		st.counter("read_bytes", (double)(process_read_bytes()-r0)/st.samples.size());
+	set_direct_io(false);
+}
+
+static void load_key_op(bench_env& e, bench_state& st){
+	vector<vector<Ec1> > prk;
+	vector<Ec2> vrk;
+	e.a->load_key(prk,vrk);
+}
+
+static void calc_update_key_op(bench_env& e, bench_state& st){
+	st.pause();
+	long long i = random_index(e);
+	st.resume();
+	benchmark::DoNotOptimize(e.a->calc_update_key(i,e.prk));
+}
+
+static void calc_update_key_batch_op(bench_env& e, bench_state& st){
+	st.pause();
+	vector<long long> index(st.batch);
+	for(long long j=0;j<st.batch;j++)
+		index[j] = random_index(e);
+	st.resume();
+	benchmark::DoNotOptimize(e.a->calc_update_key_batch(index,e.prk));
+}
+
+//update keys of the PROOF_POOL indices with the page cache dropped, so only the upk_cache can serve them
+static void hot_update_key_op(bench_env& e, bench_state& st){
+	st.pause();
+	long long i = e.index[e.gen() % PROOF_POOL];
+	st.resume();
+	benchmark::DoNotOptimize(e.a->calc_update_key(i,e.prk));
+}
+
+static void hot_case(bench_state& st, bool cached){
+	bench_env& e = env(st.L);
+	if(cached)
+		e.a->enable_cache(1<<16, 1024, 4); //room to spare, the segments do not fill evenly
+	io_case(st, CACHE_COLD, hot_update_key_op);
+	if(cached){
+		st.counter("upk_hits", e.a->cache->upk_hits);
+		st.counter("upk_misses", e.a->cache->upk_misses);
+		e.a->disable_cache();
+	}
+}
+
+static void load_key(bench_state& st){ io_case(st, CACHE_WARM, load_key_op); }
+static void load_key_cold(bench_state& st){ io_case(st, CACHE_COLD, load_key_op); }
+static void load_key_direct(bench_state& st){ io_case(st, CACHE_DIRECT, load_key_op); }
+BENCH_CASE(load_key);
+BENCH_CASE(load_key_cold);
+BENCH_CASE(load_key_direct);
+
+static void calc_update_key(bench_state& st){ io_case(st, CACHE_WARM, calc_update_key_op); }
+static void calc_update_key_cold(bench_state& st){ io_case(st, CACHE_COLD, calc_update_key_op); }
+static void calc_update_key_direct(bench_state& st){ io_case(st, CACHE_DIRECT, calc_update_key_op); }
+BENCH_CASE(calc_update_key);
+BENCH_CASE(calc_update_key_cold);
+BENCH_CASE(calc_update_key_direct);
+
+static void calc_update_key_hot(bench_state& st){ hot_case(st, false); }
+static void calc_update_key_hot_cached(bench_state& st){ hot_case(st, true); }
+BENCH_CASE(calc_update_key_hot);
+BENCH_CASE(calc_update_key_hot_cached);
+
+static void calc_update_key_batch(bench_state& st){ io_case(st, CACHE_WARM, calc_update_key_batch_op); }
+static void calc_update_key_batch_cold(bench_state& st){ io_case(st, CACHE_COLD, calc_update_key_batch_op); }
+static void calc_update_key_batch_direct(bench_state& st){ io_case(st, CACHE_DIRECT, calc_update_key_batch_op); }
+BENCH_CASE_BATCHED(calc_update_key_batch);
+BENCH_CASE_BATCHED(calc_update_key_batch_cold);
+BENCH_CASE_BATCHED(calc_update_key_batch_direct);
+
+static void setup(bench_state& st){
+	bench_env& e = env(st.L);
+	while(st.keep_running())
+		benchmark::DoNotOptimize(e.a->setup(e.vals,e.prk));
+}
+BENCH_CASE(setup);
+
+static void prove(bench_state& st){
+	bench_env& e = env(st.L);
+	while(st.keep_running()){
+		st.pause();
+		long long i = random_index(e);
+		st.resume();
+		benchmark::DoNotOptimize(e.a->prove(i,e.vals,e.prk));
+	}
+}
+BENCH_CASE(prove);
+
+static void verify(bench_state& st){
+	bench_env& e = env(st.L);
+	int j = 0;
+	while(st.keep_running()){
+		bool ok = e.a->verify(e.digest,e.index[j],e.vals[e.index[j]],e.proofs[j],e.vrk);
+		benchmark::DoNotOptimize(ok);
+		j = (j+1)%PROOF_POOL;
+	}
+}
+BENCH_CASE(verify);
+
+static void batch_verify(bench_state& st){
+	bench_env& e = env(st.L);
+	vector<long long> index(st.batch);
+	vector<mpz_class> a_i(st.batch);
+	vector<vector<Ec1> > proofs(st.batch);
+	for(long long j=0;j<st.batch;j++){
+		index[j] = e.index[j%PROOF_POOL];
+		a_i[j] = e.vals[index[j]];
+		proofs[j] = e.proofs[j%PROOF_POOL];
+	}
+	while(st.keep_running()){
+		bool ok = e.a->batch_verify(e.digest,index,a_i,proofs,e.vrk);
+		benchmark::DoNotOptimize(ok);
+	}
+}
+BENCH_CASE_BATCHED(batch_verify);
+
+static void update_digest(bench_state& st){
+	bench_env& e = env(st.L);
+	uniform_int_distribution<int> vdistrib(0, numeric_limits<int>::max());
+	Ec1 digest = e.digest;
+	while(st.keep_running()){
+		st.pause();
+		long long i = random_index(e);
+		mpz_class delta = vdistrib(e.gen);
+		vector<Ec1> upk = e.a->calc_update_key(i,e.prk);
+		st.resume();
+		benchmark::DoNotOptimize(digest = e.a->update_digest(digest,i,delta,upk));
+	}
+}
+BENCH_CASE(update_digest);
+
+static void update_proof(bench_state& st){
+	bench_env& e = env(st.L);
+	uniform_int_distribution<int> vdistrib(0, numeric_limits<int>::max());
+	vector<Ec1> proof = e.proofs[0];
+	while(st.keep_running()){
+		st.pause();
+		long long i = random_index(e);
+		mpz_class delta = vdistrib(e.gen);
+		vector<Ec1> upk = e.a->calc_update_key(i,e.prk);
+		st.resume();
+		benchmark::DoNotOptimize(proof = e.a->update_proof(proof,i,e.index[0],delta,upk));
+	}
+}
+BENCH_CASE(update_proof);
+
+int main(int argc, char** argv){
+	bench_options options;
+	if(!bench_parse(argc,argv,options))
+		return 1;
+
+	bn::CurveParam cp = bn::CurveFp254BNb;
+	Param::init(cp);
+	const Point& pt = selectPoint(cp);
+	g2 = Ec2(
+		Fp2(Fp(pt.g2.aa), Fp(pt.g2.ab)),
+		Fp2(Fp(pt.g2.ba), Fp(pt.g2.bb))
+	);
+	g1 = Ec1(pt.g1.a, pt.g1.b);
+	p.set_str("16798108731015832284940804142231733909759579603404752749028378864165570215949",10);
+
+	bench_context("glv", glv_enabled() ? "on" : "off");
+	bench_context("ec1_batch", ec1_batch_backend());
+#ifdef VCS_IO_URING
+	bench_context("io", "io_uring");
+#else
+	bench_context("io", "pread");
+#endif
+
+	return bench_run(options);
+}
@@ -0,0 +1,111 @@
+#ifndef VCS_FIXED_H
+#define VCS_FIXED_H
+
+#include <array>
+#include "vcs.h"
+#include "glv.h"
+#include "ec1_batch.h"
+
+//vcs with the depth L fixed at compile time. proofs, update keys and vrk are std::arrays, index bits are
+//extracted with shifts, and the per-level loops of verify, update_digest and update_proof are unrolled by
+//fixed_unroll, so none of them allocates a container. scalars go through ec1_mul (glv.h).
+//keys and proofs come from the runtime vcs via to_array.
+
+//runs f(0), f(1), ..., f(N-1), stopping after the first call that returns false
+template< int N >
+struct fixed_unroll{
+	template< class F >
+	static bool run(F& f){
+		return fixed_unroll<N-1>::run(f) && f(N-1);
+	}
+};
+
+template<>
+struct fixed_unroll<0>{
+	template< class F >
+	static bool run(F& f){
+		return true;
+	}
+};
+
+template< int L >
+class vcs_fixed{
+	public:
+	typedef array<Ec1,L> proof_t; //also the type of an update key
+	typedef array<Ec2,L> vrk_t;
+	
+	static const long long N = (long long)1<<L;
+	
+	mpz_class p;
+	Ec1 g1;
+	Ec2 g2;
+	
+	vcs_fixed(mpz_class p, Ec1 g1, Ec2 g2){
+		this->p = p;
+		this->g1 = g1;
+		this->g2 = g2;
+	}
+	
+	static constexpr int bit(long long index, int i){ //LSB first, like to_binary
+		return (index >> i) & 1;
+	}
+	
+	template< class T >
+	static array<T,L> to_array(const vector<T>& v){
+		array<T,L> a;
+		for(int i=0;i<L;i++)
+			a[i] = v[i];
+		return a;
+	}
+	
+	bool verify(const Ec1& digest, long long index, const mpz_class& a_i, const proof_t& proof, const vrk_t& vrk) const{
+		Fp12 e1, e2, e3 = 1;
+		
+		opt_atePairing(e1, g2, ec1_sub(digest,ec1_mul(g1,a_i)));
+		
+		struct level{
+			const vcs_fixed* self; long long index; const proof_t* proof; const vrk_t* vrk; Fp12* e2; Fp12* e3;
+			bool operator()(int i){
+				if(bit(index,i))
+					opt_atePairing(*e2, (*vrk)[L-i-1]-self->g2, (*proof)[i]);
+				else
+					opt_atePairing(*e2, (*vrk)[L-i-1], (*proof)[i]);
+				*e3 *= *e2;
+				return true;
+			}
+		} f = {this, index, &proof, &vrk, &e2, &e3};
+		fixed_unroll<L>::run(f);
+		
+		return e1==e3;
+	}
+	
+	Ec1 update_digest(const Ec1& digest, long long updateindex, const mpz_class& delta, const proof_t& upk_u) const{
+		return ec1_add(digest,ec1_mul(upk_u[L-1],delta));
+	}
+	
+	//same rule as vcs::update_proof: level i moves by -+delta*upk_u[L-i-2] (g1 at the last level) for bit i of
+	//updateindex 0/1, and stops at the first bit where updateindex and index differ
+	proof_t update_proof(const proof_t& proof, long long updateindex, long long index, const mpz_class& delta, const proof_t& upk_u) const{
+		proof_t new_proof = proof;
+		
+		struct level{
+			const vcs_fixed* self; long long updateindex, index; const mpz_class* delta; const proof_t* upk_u; proof_t* new_proof;
+			bool operator()(int i){
+				const Ec1& base = i<L-1 ? (*upk_u)[L-i-2] : self->g1;
+				Ec1 term = ec1_mul(base,*delta);
+				
+				if(bit(updateindex,i))
+					(*new_proof)[i] = ec1_add((*new_proof)[i],term);
+				else
+					(*new_proof)[i] = ec1_sub((*new_proof)[i],term);
+				
+				return bit(updateindex,i)==bit(index,i);
+			}
+		} f = {this, updateindex, index, &delta, &upk_u, &new_proof};
+		fixed_unroll<L>::run(f);
+		
+		return new_proof;
+	}
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "wire.h"
+
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <gmpxx.h>
+
+#define ncore 16
+#define WIRE_MIN_CHUNK 256 //fewer points are not split across threads
+
+#define FLAG_INFINITY 0x80
+#define FLAG_ODD 0x40
+
+//the field prime of CurveFp254BNb, q = 3 mod 4
+#define WIRE_Q "16798108731015832284940804142231733909889187121439069848933715426072753864723"
+
+struct affine{
+	mpz_class x, y;
+	bool inf;
+};
+
+//how Fp keeps its value in its 4x64-bit limbs: value*R mod q for some R (R = 2^256 for Montgomery form).
+//found once from Fp(1) and checked on other values; if no such R fits, values go through strings.
+struct fp_repr{
+	mpz_class q, e, R, Rinv;
+	bool raw;
+
+	static mpz_class limbs(const Fp& a){
+		mpz_class z;
+		mpz_import(z.get_mpz_t(),4,-1,sizeof(uint64_t),0,0,&a);
+		return z;
+	}
+
+	fp_repr():q(WIRE_Q){
+		e = (q+1)/4;
+		raw = sizeof(Fp)==4*sizeof(uint64_t);
+		if(raw){
+			R = limbs(Fp(1));
+			raw = R!=0 && limbs(Fp(2))==(2*R)%q && limbs(Fp(-1))==(q-R)%q && limbs(Fp(12345))==(12345*R)%q;
+		}
+		if(raw)
+			mpz_invert(Rinv.get_mpz_t(),R.get_mpz_t(),q.get_mpz_t());
+	}
+
+	mpz_class get(const Fp& a) const{
+		if(raw)
+			return limbs(a)*Rinv%q;
+		return mpz_class(a.toString());
+	}
+
+	void set(Fp& a, const mpz_class& x) const{
+		if(raw){
+			mpz_class z = x*R%q;
+			size_t count;
+			memset(&a,0,sizeof(Fp));
+			mpz_export(&a,&count,-1,sizeof(uint64_t),0,0,z.get_mpz_t());
+		}
+		else
+			a = Fp(x.get_str().c_str());
+	}
+};
+
+static const fp_repr& repr(){
+	static fp_repr r;
+	return r;
+}
+
+//Jacobian (X,Y,Z) -> (X/Z^2, Y/Z^3), one inversion for the whole array
+static void to_affine(const Ec1* points, size_t n, affine* out){
+	const fp_repr& f = repr();
+	vector<mpz_class> z(n), prefix(n+1);
+
+	prefix[0] = 1;
+	for(size_t i=0;i<n;i++){
+		z[i] = f.get(points[i].p[2]);
+		out[i].inf = z[i]==0;
+		prefix[i+1] = out[i].inf ? prefix[i] : prefix[i]*z[i]%f.q;
+	}
+
+	mpz_class inv;
+	mpz_invert(inv.get_mpz_t(),prefix[n].get_mpz_t(),f.q.get_mpz_t());
+
+	for(size_t i=n;i-->0;){
+		if(out[i].inf)
+			continue;
+		mpz_class zi = inv*prefix[i]%f.q, zi2 = zi*zi%f.q;
+		inv = inv*z[i]%f.q;
+		out[i].x = f.get(points[i].p[0])*zi2%f.q;
+		out[i].y = f.get(points[i].p[1])*zi2%f.q*zi%f.q;
+	}
+}
+
+static void put_point(const affine& a, unsigned char* out){
+	memset(out,0,EC1_BYTES);
+	if(a.inf){
+		out[0] = FLAG_INFINITY;
+		return;
+	}
+	size_t count;
+	unsigned char buf[EC1_BYTES];
+	mpz_export(buf,&count,1,1,1,0,a.x.get_mpz_t());
+	memcpy(out+EC1_BYTES-count,buf,count);
+	if(mpz_odd_p(a.y.get_mpz_t()))
+		out[0] |= FLAG_ODD;
+}
+
+static bool get_point(const unsigned char* in, affine& a){
+	const fp_repr& f = repr();
+	unsigned char buf[EC1_BYTES];
+	memcpy(buf,in,EC1_BYTES);
+
+	a.inf = buf[0]&FLAG_INFINITY;
+	bool odd = buf[0]&FLAG_ODD;
+	buf[0] &= ~(FLAG_INFINITY|FLAG_ODD);
+	mpz_import(a.x.get_mpz_t(),EC1_BYTES,1,1,1,0,buf);
+
+	if(a.inf)
+		return !odd && a.x==0;
+	if(a.x>=f.q)
+		return false;
+
+	mpz_class rhs = (a.x*a.x*a.x+2)%f.q;
+	mpz_powm(a.y.get_mpz_t(),rhs.get_mpz_t(),f.e.get_mpz_t(),f.q.get_mpz_t());
+	if(a.y*a.y%f.q!=rhs)
+		return false;
+	if(mpz_odd_p(a.y.get_mpz_t())!=odd)
+		a.y = f.q-a.y;
+	if(a.y==0 && odd) //y = 0 has no odd encoding
+		return false;
+	return true;
+}
+
+static void set_point(const affine& a, Ec1& p){
+	const fp_repr& f = repr();
+	f.set(p.p[0],a.inf ? mpz_class(0) : a.x);
+	f.set(p.p[1],a.inf ? mpz_class(0) : a.y);
+	f.set(p.p[2],a.inf ? mpz_class(0) : mpz_class(1));
+}
+
+static int chunks(size_t n){
+	size_t k = n/WIRE_MIN_CHUNK;
+	return k<1 ? 1 : k>ncore ? ncore : k;
+}
+
+void encode_points(const Ec1* points, size_t n, unsigned char* out){
+	repr();
+
+	auto f = [](size_t x, size_t y, const Ec1* points, unsigned char* out) {
+		vector<affine> a(y-x);
+		to_affine(points+x,y-x,a.data());
+		for(size_t i=x;i<y;i++)
+			put_point(a[i-x],out+i*EC1_BYTES);
+	};
+
+	int k = chunks(n);
+	thread th[ncore];
+	for(int t=0;t<k;t++)
+		th[t]=thread(f,n/k*t,t==k-1 ? n : n/k*(t+1),points,out);
+	for(int t=0;t<k;t++)
+		th[t].join();
+}
+
+bool decode_points(const unsigned char* in, size_t n, Ec1* points){
+	repr();
+
+	auto f = [](size_t x, size_t y, const unsigned char* in, Ec1* points, bool* ok) {
+		affine a;
+		*ok = true;
+		for(size_t i=x;i<y && *ok;i++){
+			*ok = get_point(in+i*EC1_BYTES,a);
+			set_point(a,points[i]);
+		}
+	};
+
+	int k = chunks(n);
+	thread th[ncore];
+	bool ok[ncore];
+	for(int t=0;t<k;t++)
+		th[t]=thread(f,n/k*t,t==k-1 ? n : n/k*(t+1),in,points,&ok[t]);
+	for(int t=0;t<k;t++)
+		th[t].join();
+
+	for(int t=0;t<k;t++){
+		if(!ok[t])
+			return false;
+	}
+	return true;
+}
+
+string encode_digest(const Ec1& digest){
+	string out(EC1_BYTES,0);
+	encode_points(&digest,1,(unsigned char*)&out[0]);
+	return out;
+}
+
+bool decode_digest(const string& in, Ec1& digest){
+	if(in.size()!=EC1_BYTES)
+		return false;
+	return decode_points((const unsigned char*)in.data(),1,&digest);
+}
+
+string encode_proof(const vector<Ec1>& proof){
+	string out(proof.size()*EC1_BYTES,0);
+	encode_points(proof.data(),proof.size(),(unsigned char*)&out[0]);
+	return out;
+}
+
+bool decode_proof(const string& in, int L, vector<Ec1>& proof){
+	if(in.size()!=(size_t)L*EC1_BYTES)
+		return false;
+	proof.resize(L);
+	return decode_points((const unsigned char*)in.data(),L,proof.data());
+}
+
+string encode_proofs(const vector<vector<Ec1> >& proofs){
+	vector<Ec1> all;
+	for(size_t i=0;i<proofs.size();i++)
+		all.insert(all.end(),proofs[i].begin(),proofs[i].end());
+	string out(all.size()*EC1_BYTES,0);
+	encode_points(all.data(),all.size(),(unsigned char*)&out[0]);
+	return out;
+}
+
+bool decode_proofs(const string& in, int L, vector<vector<Ec1> >& proofs){
+	size_t proof_bytes = (size_t)L*EC1_BYTES;
+	if(L<=0 || in.size()%proof_bytes!=0)
+		return false;
+
+	size_t count = in.size()/proof_bytes;
+	vector<Ec1> all(count*L);
+	if(!decode_points((const unsigned char*)in.data(),all.size(),all.data()))
+		return false;
+
+	proofs.resize(count);
+	for(size_t i=0;i<count;i++)
+		proofs[i].assign(all.begin()+i*L,all.begin()+(i+1)*L);
+	return true;
+}
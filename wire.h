@@ -0,0 +1,31 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <vector>
+#include <string>
+#include "bn.h"
+
+using namespace std;
+using namespace bn;
+
+#define EC1_BYTES 32
+
+//compressed G1 points: affine x big-endian in 32 bytes, the top bit of the first byte marks the point at
+//infinity and the next one the parity of y. decoding takes the square root of x^3+2, which is also the
+//on-curve check; G1 has cofactor 1, so no separate subgroup check is needed.
+//arrays of points are encoded and decoded by ncore threads, encoding shares one inversion per thread to
+//get affine coordinates. decoding fails on non-canonical x, bad flags or x not on the curve.
+void encode_points(const Ec1* points, size_t n, unsigned char* out);
+bool decode_points(const unsigned char* in, size_t n, Ec1* points);
+
+string encode_digest(const Ec1& digest);
+bool decode_digest(const string& in, Ec1& digest);
+
+string encode_proof(const vector<Ec1>& proof);
+bool decode_proof(const string& in, int L, vector<Ec1>& proof);
+
+//many proofs of L points back to back, e.g. all proofs of a block, decoded in one batch for batch_verify
+string encode_proofs(const vector<vector<Ec1> >& proofs);
+bool decode_proofs(const string& in, int L, vector<vector<Ec1> >& proofs);
+
+#endif